@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * Runs `bench` several times and compares the median time of each
+ * benchmark with a baseline file, one JSON object per line:
+ *
+ *     {"bench": "shortest_path", "graph": "grid", "median": ..., "mad": ...}
+ *
+ * A benchmark regresses when its median is slower than the baseline by
+ * more than `threshold` (relative) and by more than `sigmas` times the
+ * noise, taken as 1.4826 times the larger of the two median absolute
+ * deviations, i.e., a robust standard deviation.  Both conditions are
+ * needed, so that neither a noisy benchmark nor a tiny but stable
+ * difference fails the gate.
+ *
+ * Prints a table of deltas and exits with 1 if any benchmark regressed,
+ * or, without `--filter`, if a benchmark of the baseline did not run,
+ * e.g., because it was renamed or crashed; record a new baseline
+ * after renaming one.
+ * With `--update`, writes the measured medians to the baseline instead.
+ * Times only compare on the same machine and compiler flags, so no
+ * baseline is checked in.  `make gate-baseline` records
+ * `bench-baseline.json` with the `bench` built by this Makefile, and
+ * `make gate` checks against it, e.g., before and after a change in CI.
+ *
+ * Usage: bench-gate [options] baseline
+ *
+ *     --runs n          number of runs of bench (default 5)
+ *     --threshold t     relative slowdown allowed (default 0.1)
+ *     --sigmas s        slowdown allowed in robust deviations (default 3)
+ *     --bench path      bench binary (default ./bench)
+ *     --filter f        passed to bench
+ *     --update          rewrite the baseline
+ *
+ */
+
+struct stats {
+    double median;
+    double mad;
+};
+
+std::string get_string(std::string const& line, std::string const& key)
+{
+    std::string pattern = "\"" + key + "\": \"";
+    auto pos = line.find(pattern);
+
+    if (pos == std::string::npos) {
+        return "";
+    }
+
+    pos += pattern.size();
+
+    return line.substr(pos, line.find('"', pos) - pos);
+}
+
+double get_number(std::string const& line, std::string const& key)
+{
+    std::string pattern = "\"" + key + "\": ";
+    auto pos = line.find(pattern);
+
+    if (pos == std::string::npos) {
+        return std::nan("");
+    }
+
+    return std::atof(line.c_str() + pos + pattern.size());
+}
+
+double median(std::vector<double> v)
+{
+    std::sort(v.begin(), v.end());
+
+    int n = v.size();
+
+    return n % 2 == 1 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+stats robust_stats(std::vector<double> const& v)
+{
+    double m = median(v);
+
+    std::vector<double> dev;
+
+    for (auto& x: v) {
+        dev.push_back(std::fabs(x - m));
+    }
+
+    return stats { m, median(dev) };
+}
+
+/*
+ * Runs bench once and appends the time of each benchmark, keyed by
+ * "bench/graph".
+ *
+ */
+bool run_bench(std::string const& command, std::map<std::string, std::vector<double>>& times)
+{
+    FILE *p = popen(command.c_str(), "r");
+
+    if (p == nullptr) {
+        return false;
+    }
+
+    char buf[4096];
+
+    while (fgets(buf, sizeof(buf), p) != nullptr) {
+        std::string line { buf };
+
+        std::string bench = get_string(line, "bench");
+        std::string graph = get_string(line, "graph");
+        double seconds = get_number(line, "seconds");
+
+        if (bench.size() == 0 || std::isnan(seconds)) {
+            continue;
+        }
+
+        times[bench + "/" + graph].push_back(seconds);
+    }
+
+    return pclose(p) == 0;
+}
+
+std::map<std::string, stats> load_baseline(std::string const& filename)
+{
+    std::map<std::string, stats> result;
+
+    std::ifstream ifs { filename };
+    std::string line;
+
+    while (std::getline(ifs, line)) {
+        std::string bench = get_string(line, "bench");
+
+        if (bench.size() == 0) {
+            continue;
+        }
+
+        result[bench + "/" + get_string(line, "graph")]
+            = stats { get_number(line, "median"), get_number(line, "mad") };
+    }
+
+    return result;
+}
+
+void save_baseline(std::string const& filename, std::map<std::string, stats> const& measured)
+{
+    std::ofstream ofs { filename };
+
+    for (auto& p: measured) {
+        auto slash = p.first.find('/');
+
+        ofs << "{\"bench\": \"" << p.first.substr(0, slash) << "\""
+            << ", \"graph\": \"" << p.first.substr(slash + 1) << "\""
+            << ", \"median\": " << p.second.median
+            << ", \"mad\": " << p.second.mad
+            << "}" << std::endl;
+    }
+}
+
+void usage()
+{
+    std::cerr << "usage: bench-gate [--runs n] [--threshold t] [--sigmas s]"
+        " [--bench path] [--filter f] [--update] baseline" << std::endl;
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    int runs = 5;
+    double threshold = 0.1;
+    double sigmas = 3;
+    std::string bench = "./bench";
+    std::string filter;
+    bool update = false;
+    std::string baseline_file;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+
+        if (arg == "--update") {
+            update = true;
+        } else if (arg.size() > 2 && arg.substr(0, 2) == "--") {
+            if (i + 1 == argc) {
+                usage();
+            }
+
+            std::string value = argv[++i];
+
+            if (arg == "--runs") {
+                runs = std::atoi(value.c_str());
+            } else if (arg == "--threshold") {
+                threshold = std::atof(value.c_str());
+            } else if (arg == "--sigmas") {
+                sigmas = std::atof(value.c_str());
+            } else if (arg == "--bench") {
+                bench = value;
+            } else if (arg == "--filter") {
+                filter = value;
+            } else {
+                usage();
+            }
+        } else if (baseline_file.size() == 0) {
+            baseline_file = arg;
+        } else {
+            usage();
+        }
+    }
+
+    if (baseline_file.size() == 0 || runs < 1) {
+        usage();
+    }
+
+    std::string command = bench + (filter.size() > 0 ? " '" + filter + "'" : "");
+
+    std::map<std::string, std::vector<double>> times;
+
+    for (int r = 0; r < runs; ++r) {
+        if (!run_bench(command, times)) {
+            std::cerr << "failed to run " << command << std::endl;
+            return 2;
+        }
+    }
+
+    std::map<std::string, stats> measured;
+
+    for (auto& p: times) {
+        measured[p.first] = robust_stats(p.second);
+    }
+
+    if (update) {
+        save_baseline(baseline_file, measured);
+        std::cout << "wrote " << measured.size() << " benchmarks to " << baseline_file << std::endl;
+        return 0;
+    }
+
+    std::map<std::string, stats> baseline = load_baseline(baseline_file);
+
+    int regressions = 0;
+
+    std::cout << std::left << std::setw(32) << "benchmark"
+        << std::right << std::setw(12) << "baseline"
+        << std::setw(12) << "median"
+        << std::setw(12) << "mad"
+        << std::setw(10) << "delta"
+        << "  status" << std::endl;
+
+    std::cout << std::fixed;
+
+    for (auto& p: measured) {
+        std::cout << std::left << std::setw(32) << p.first << std::right;
+
+        auto iter = baseline.find(p.first);
+
+        if (iter == baseline.end()) {
+            std::cout << std::setw(12) << "-"
+                << std::setprecision(4) << std::setw(12) << p.second.median
+                << std::setw(12) << p.second.mad
+                << std::setw(10) << "-"
+                << "  new" << std::endl;
+
+            continue;
+        }
+
+        stats const& base = iter->second;
+
+        double diff = p.second.median - base.median;
+        double noise = 1.4826 * std::max(p.second.mad, base.mad);
+
+        std::string status = "ok";
+
+        if (diff > threshold * base.median && diff > sigmas * noise) {
+            status = "REGRESSED";
+            ++regressions;
+        } else if (-diff > threshold * base.median && -diff > sigmas * noise) {
+            status = "improved";
+        }
+
+        std::cout << std::setprecision(4) << std::setw(12) << base.median
+            << std::setw(12) << p.second.median
+            << std::setw(12) << p.second.mad
+            << std::setprecision(1) << std::setw(9) << 100 * diff / base.median << "%"
+            << "  " << status << std::endl;
+    }
+
+    int missing = 0;
+
+    for (auto& p: baseline) {
+        if (filter.size() == 0 && measured.find(p.first) == measured.end()) {
+            std::cout << std::left << std::setw(32) << p.first << std::right
+                << std::setprecision(4) << std::setw(12) << p.second.median
+                << std::setw(12) << "-" << std::setw(12) << "-" << std::setw(10) << "-"
+                << "  MISSING" << std::endl;
+            ++missing;
+        }
+    }
+
+    if (regressions > 0) {
+        std::cout << regressions << " regressions" << std::endl;
+    }
+
+    if (missing > 0) {
+        std::cout << missing << " benchmarks of the baseline did not run" << std::endl;
+    }
+
+    return regressions > 0 || missing > 0 ? 1 : 0;
+}
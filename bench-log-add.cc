@@ -0,0 +1,172 @@
+#include "fst/ifst.h"
+#include "fst/fst-algo.h"
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <iomanip>
+
+/*
+ * Measures the speed and the error of the log-add implementations in
+ * `fst-semiring.h`, on their own and inside `forward_log_sum`.
+ *
+ */
+
+/*
+ * Sums are stored here so that the timed loops are not optimized
+ * away.
+ */
+volatile double sink;
+
+template <class log_add_type>
+double max_error()
+{
+    using real = typename log_add_type::value_type;
+
+    double max = 0;
+
+    for (int i = 0; i <= 300000; ++i) {
+        double a = -i * 1e-4;
+        double b = -(i % 1000) * 0.37;
+        double exact = fst::exact_log_add<double>::log_add(a, b);
+        double approx = log_add_type::log_add(real(a), real(b));
+        max = std::max(max, std::fabs(approx - exact));
+    }
+
+    return max;
+}
+
+template <class log_add_type>
+double ns_per_call(std::vector<double> const& a, std::vector<double> const& b)
+{
+    using real = typename log_add_type::value_type;
+
+    std::vector<real> ra { a.begin(), a.end() };
+    std::vector<real> rb { b.begin(), b.end() };
+
+    auto start = std::chrono::steady_clock::now();
+
+    real s = 0;
+
+    for (int i = 0; i < ra.size(); ++i) {
+        s += log_add_type::log_add(ra[i], rb[i]);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    sink = s;
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ra.size();
+}
+
+ifst::fst make_grid(int frames, int states, std::mt19937& gen)
+{
+    std::uniform_real_distribution<double> dist { -5, 0 };
+
+    ifst::fst f;
+    f.data = std::make_shared<ifst::fst_data>();
+
+    for (int t = 0; t <= frames; ++t) {
+        for (int s = 0; s < states; ++s) {
+            ifst::add_vertex(*f.data, t * states + s, ifst::vertex_data { t });
+        }
+    }
+
+    int e = 0;
+
+    for (int t = 0; t < frames; ++t) {
+        for (int s1 = 0; s1 < states; ++s1) {
+            for (int s2 = 0; s2 < states; ++s2) {
+                ifst::add_edge(*f.data, e, ifst::edge_data { t * states + s1,
+                    (t + 1) * states + s2, dist(gen), s2, s2 });
+                ++e;
+            }
+        }
+    }
+
+    for (int s = 0; s < states; ++s) {
+        f.data->initials.push_back(s);
+        f.data->finals.push_back(frames * states + s);
+    }
+
+    return f;
+}
+
+template <class log_add_type>
+void bench_log_sum(std::string const& name, ifst::fst const& f,
+    std::vector<int> const& order, double exact)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    fst::forward_log_sum<ifst::fst, log_add_type> log_sum;
+    log_sum.merge(f, order);
+
+    auto end = std::chrono::steady_clock::now();
+
+    double total = -std::numeric_limits<double>::infinity();
+    for (auto& v: f.finals()) {
+        if (ebt::in(v, log_sum.extra)) {
+            total = fst::exact_log_add<double>::log_add(total, log_sum.extra.at(v));
+        }
+    }
+
+    std::cout << std::left << std::setw(32) << ("forward_log_sum/" + name)
+        << std::setw(14) << std::chrono::duration<double, std::milli>(end - start).count()
+        << std::setw(14) << std::fabs(total - exact) / std::fabs(exact) << std::endl;
+}
+
+int main()
+{
+    std::mt19937 gen { 1 };
+    std::uniform_real_distribution<double> dist { -20, 0 };
+
+    std::vector<double> a;
+    std::vector<double> b;
+
+    for (int i = 0; i < 10000000; ++i) {
+        a.push_back(dist(gen));
+        b.push_back(dist(gen));
+    }
+
+    std::cout << std::left << std::setw(28) << "log_add" << std::setw(14) << "ns/call"
+        << std::setw(14) << "max abs err" << std::endl;
+
+    std::cout << std::setw(28) << "exact<double>" << std::setw(14) << ns_per_call<fst::exact_log_add<double>>(a, b)
+        << std::setw(14) << max_error<fst::exact_log_add<double>>() << std::endl;
+    std::cout << std::setw(28) << "exact<float>" << std::setw(14) << ns_per_call<fst::exact_log_add<float>>(a, b)
+        << std::setw(14) << max_error<fst::exact_log_add<float>>() << std::endl;
+    std::cout << std::setw(28) << "table<double>" << std::setw(14) << ns_per_call<fst::table_log_add<double>>(a, b)
+        << std::setw(14) << max_error<fst::table_log_add<double>>() << std::endl;
+    std::cout << std::setw(28) << "table<float>" << std::setw(14) << ns_per_call<fst::table_log_add<float>>(a, b)
+        << std::setw(14) << max_error<fst::table_log_add<float>>() << std::endl;
+    std::cout << std::setw(28) << "poly<double>" << std::setw(14) << ns_per_call<fst::poly_log_add<double>>(a, b)
+        << std::setw(14) << max_error<fst::poly_log_add<double>>() << std::endl;
+    std::cout << std::setw(28) << "poly<float>" << std::setw(14) << ns_per_call<fst::poly_log_add<float>>(a, b)
+        << std::setw(14) << max_error<fst::poly_log_add<float>>() << std::endl;
+
+    std::cout << std::endl;
+
+    ifst::fst f = make_grid(500, 40, gen);
+    std::vector<int> order = fst::topo_order(f);
+
+    fst::forward_log_sum<ifst::fst> ref;
+    ref.merge(f, order);
+
+    double exact = -std::numeric_limits<double>::infinity();
+    for (auto& v: f.finals()) {
+        if (ebt::in(v, ref.extra)) {
+            exact = fst::exact_log_add<double>::log_add(exact, ref.extra.at(v));
+        }
+    }
+
+    std::cout << std::left << std::setw(32) << "algorithm" << std::setw(14) << "ms"
+        << std::setw(14) << "rel err" << std::endl;
+
+    bench_log_sum<fst::exact_log_add<double>>("exact<double>", f, order, exact);
+    bench_log_sum<fst::exact_log_add<float>>("exact<float>", f, order, exact);
+    bench_log_sum<fst::table_log_add<double>>("table<double>", f, order, exact);
+    bench_log_sum<fst::table_log_add<float>>("table<float>", f, order, exact);
+    bench_log_sum<fst::poly_log_add<double>>("poly<double>", f, order, exact);
+    bench_log_sum<fst::poly_log_add<float>>("poly<float>", f, order, exact);
+
+    return 0;
+}
@@ -0,0 +1,484 @@
+#include "fst/ifst.h"
+#include "fst/fst-algo.h"
+#include <sys/resource.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <unordered_set>
+
+/*
+ * Benchmarks the main algorithms on synthetic graphs shaped like the
+ * ones we decode with, and prints one JSON object per line:
+ *
+ *     {"bench": "shortest_path", "graph": "grid", "vertices": ...,
+ *      "edges": ..., "work": ..., "seconds": ..., "edges_per_sec": ...,
+ *      "allocs": ..., "alloc_bytes": ..., "peak_rss_kb": ...}
+ *
+ * `vertices` and `edges` describe the graph, or, for composition, the
+ * part of the composition reachable from its initial vertices.  `work`
+ * is the number of edges the benchmark touches, i.e., the edges of
+ * the graph, or the edges expanded for composition.  `allocs` and
+ * `alloc_bytes` count calls to `operator new` during the benchmark.
+ * `peak_rss_kb` is the peak of the whole process so far.
+ *
+ * Usage: bench [filter]
+ *
+ * Only benchmarks whose "bench/graph" name contains `filter` are run.
+ *
+ */
+
+namespace fst {
+
+    template <>
+    struct edge_trait<int> {
+        static int null;
+    };
+
+    int edge_trait<int>::null = -1;
+
+}
+
+std::atomic<long> alloc_count { 0 };
+std::atomic<long> alloc_bytes { 0 };
+
+void* operator new(std::size_t size)
+{
+    ++alloc_count;
+    alloc_bytes += size;
+
+    void *p = std::malloc(size == 0 ? 1 : size);
+
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete[](void *p) noexcept
+{
+    operator delete(p);
+}
+
+long peak_rss_kb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_maxrss;
+}
+
+ifst::fst make_fst()
+{
+    ifst::fst f;
+    f.data = std::make_shared<ifst::fst_data>();
+
+    return f;
+}
+
+/*
+ * A lattice with one vertex per frame and `branching` edges with
+ * different labels between consecutive frames, plus an edge that
+ * skips a frame every `skip` frames.
+ *
+ */
+ifst::fst make_chain(int frames, int branching, int skip, int labels, std::mt19937& gen)
+{
+    std::uniform_real_distribution<double> weight { -5, 0 };
+    std::uniform_int_distribution<int> label { 1, labels };
+
+    ifst::fst f = make_fst();
+
+    for (int t = 0; t <= frames; ++t) {
+        ifst::add_vertex(*f.data, t, ifst::vertex_data { t });
+    }
+
+    int e = 0;
+
+    for (int t = 0; t < frames; ++t) {
+        for (int b = 0; b < branching; ++b) {
+            int l = label(gen);
+            ifst::add_edge(*f.data, e, ifst::edge_data { t, t + 1, weight(gen), l, l });
+            ++e;
+        }
+
+        if (t % skip == 0 && t + 2 <= frames) {
+            int l = label(gen);
+            ifst::add_edge(*f.data, e, ifst::edge_data { t, t + 2, weight(gen), l, l });
+            ++e;
+        }
+    }
+
+    f.data->initials.push_back(0);
+    f.data->finals.push_back(frames);
+
+    return f;
+}
+
+/*
+ * An HMM-style trellis with `states` vertices per frame and an edge
+ * between every pair of states in consecutive frames.
+ *
+ */
+ifst::fst make_grid(int frames, int states, std::mt19937& gen)
+{
+    std::uniform_real_distribution<double> weight { -5, 0 };
+
+    ifst::fst f = make_fst();
+
+    for (int t = 0; t <= frames; ++t) {
+        for (int s = 0; s < states; ++s) {
+            ifst::add_vertex(*f.data, t * states + s, ifst::vertex_data { t });
+        }
+    }
+
+    int e = 0;
+
+    for (int t = 0; t < frames; ++t) {
+        for (int s1 = 0; s1 < states; ++s1) {
+            for (int s2 = 0; s2 < states; ++s2) {
+                ifst::add_edge(*f.data, e, ifst::edge_data { t * states + s1,
+                    (t + 1) * states + s2, weight(gen), s2 + 1, s2 + 1 });
+                ++e;
+            }
+        }
+    }
+
+    for (int s = 0; s < states; ++s) {
+        f.data->initials.push_back(s);
+        f.data->finals.push_back(frames * states + s);
+    }
+
+    return f;
+}
+
+/*
+ * A lexicon transducer: a tree of phone paths from vertex 0, one per
+ * word, each going back to vertex 0.  The first edge of a word outputs
+ * the word, the others output eps.  Vertex 0 is initial and final, so
+ * the transducer accepts any sequence of words.
+ *
+ * Each edge after the first of a word has input eps with probability
+ * `eps_input`, as for optional phones.  Only those edges match the
+ * eps loops of a lattice in composition.
+ *
+ */
+ifst::fst make_lexicon(int words, int max_length, int phones, std::mt19937& gen,
+    double eps_input = 0)
+{
+    std::uniform_real_distribution<double> weight { -2, 0 };
+    std::uniform_int_distribution<int> phone { 1, phones };
+    std::uniform_int_distribution<int> length { 1, max_length };
+    std::bernoulli_distribution optional { eps_input };
+
+    int eps = fst::symbol_trait<int>::eps;
+
+    ifst::fst f = make_fst();
+
+    ifst::add_vertex(*f.data, 0, ifst::vertex_data { 0 });
+
+    int v = 1;
+    int e = 0;
+
+    for (int w = 1; w <= words; ++w) {
+        int n = length(gen);
+        int tail = 0;
+
+        for (int i = 0; i < n; ++i) {
+            int head = 0;
+
+            if (i < n - 1) {
+                head = v;
+                ifst::add_vertex(*f.data, v, ifst::vertex_data { 0 });
+                ++v;
+            }
+
+            int input = phone(gen);
+
+            if (i > 0 && optional(gen)) {
+                input = eps;
+            }
+
+            ifst::add_edge(*f.data, e, ifst::edge_data { tail, head, weight(gen),
+                input, (i == 0 ? w : eps) });
+            ++e;
+
+            tail = head;
+        }
+    }
+
+    f.data->initials.push_back(0);
+    f.data->finals.push_back(0);
+
+    return f;
+}
+
+/*
+ * A random graph with back edges.  Every vertex is reachable from
+ * vertex 0 and all weights are negative, as `shortest_path` without a
+ * topological order requires.
+ *
+ */
+ifst::fst make_cyclic(int vertices, int edges, std::mt19937& gen)
+{
+    std::uniform_real_distribution<double> weight { -5, -0.01 };
+    std::uniform_int_distribution<int> vertex { 0, vertices - 1 };
+
+    ifst::fst f = make_fst();
+
+    for (int v = 0; v < vertices; ++v) {
+        ifst::add_vertex(*f.data, v, ifst::vertex_data { v });
+    }
+
+    int e = 0;
+
+    for (int v = 0; v + 1 < vertices; ++v) {
+        ifst::add_edge(*f.data, e, ifst::edge_data { v, v + 1, weight(gen), 1, 1 });
+        ++e;
+    }
+
+    for (; e < edges; ++e) {
+        ifst::add_edge(*f.data, e, ifst::edge_data { vertex(gen), vertex(gen), weight(gen), 1, 1 });
+    }
+
+    f.data->initials.push_back(0);
+    f.data->finals.push_back(vertices - 1);
+
+    return f;
+}
+
+/*
+ * The size of the graph a benchmark ran on, and the number of edges it
+ * touched.
+ *
+ */
+struct bench_size {
+    long vertices;
+    long edges;
+    long work;
+};
+
+/*
+ * Expands a composition from its initial vertices and returns the
+ * number of vertices and edges reached.  Every edge is visited once,
+ * so `work` is the number of edges.
+ *
+ */
+template <class fst_type>
+bench_size expand(fst_type const& f)
+{
+    using vertex = typename fst_type::vertex;
+
+    std::unordered_set<vertex> visited { f.initials().begin(), f.initials().end() };
+    std::vector<vertex> stack { f.initials().begin(), f.initials().end() };
+
+    long edges = 0;
+
+    while (stack.size() > 0) {
+        vertex u = stack.back();
+        stack.pop_back();
+
+        for (auto& e: f.out_edges(u)) {
+            ++edges;
+
+            vertex v = f.head(e);
+
+            if (!ebt::in(v, visited)) {
+                visited.insert(v);
+                stack.push_back(v);
+            }
+        }
+    }
+
+    return bench_size { long(visited.size()), edges, edges };
+}
+
+std::string filter;
+
+/*
+ * Runs `work_fn`, which returns a `bench_size`, and prints the result.
+ *
+ */
+template <class fn>
+void run_sized(std::string const& bench, std::string const& graph, fn work_fn)
+{
+    if (filter.size() > 0 && (bench + "/" + graph).find(filter) == std::string::npos) {
+        return;
+    }
+
+    long allocs_before = alloc_count;
+    long bytes_before = alloc_bytes;
+
+    auto start = std::chrono::steady_clock::now();
+
+    bench_size size = work_fn();
+
+    auto end = std::chrono::steady_clock::now();
+
+    long allocs = alloc_count - allocs_before;
+    long bytes = alloc_bytes - bytes_before;
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    std::cout << "{\"bench\": \"" << bench << "\""
+        << ", \"graph\": \"" << graph << "\""
+        << ", \"vertices\": " << size.vertices
+        << ", \"edges\": " << size.edges
+        << ", \"work\": " << size.work
+        << ", \"seconds\": " << seconds
+        << ", \"edges_per_sec\": " << size.work / seconds
+        << ", \"allocs\": " << allocs
+        << ", \"alloc_bytes\": " << bytes
+        << ", \"peak_rss_kb\": " << peak_rss_kb()
+        << "}" << std::endl;
+}
+
+/*
+ * Runs `work_fn`, which returns the number of edges it touched, on `f`.
+ *
+ */
+template <class fn>
+void run(std::string const& bench, std::string const& graph, ifst::fst const& f, fn work_fn)
+{
+    long vertices = f.vertices().size();
+    long edges = f.edges().size();
+
+    run_sized(bench, graph, [&]() {
+        return bench_size { vertices, edges, work_fn() };
+    });
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1) {
+        filter = argv[1];
+    }
+
+    std::mt19937 gen { 1 };
+
+    std::vector<std::pair<std::string, ifst::fst>> acyclic {
+        { "chain", make_chain(200000, 4, 7, 50, gen) },
+        { "grid", make_grid(500, 40, gen) }
+    };
+
+    for (auto& p: acyclic) {
+        ifst::fst const& f = p.second;
+        std::vector<int> order = fst::topo_order(f);
+
+        run("topo_order", p.first, f, [&]() {
+            fst::topo_order(f);
+            return long(f.edges().size());
+        });
+
+        run("shortest_path", p.first, f, [&]() {
+            fst::shortest_path(f, order);
+            return long(f.edges().size());
+        });
+
+        run("forward_log_sum", p.first, f, [&]() {
+            fst::forward_log_sum<ifst::fst> log_sum;
+            log_sum.merge(f, order);
+            return long(f.edges().size());
+        });
+
+        run("beam_search", p.first, f, [&]() {
+            fst::beam_search<ifst::fst> search;
+
+            for (auto& v: f.initials()) {
+                search.extra[v] = { fst::edge_trait<int>::null, 0 };
+            }
+
+            search.merge(f, order, 0.5, 2);
+            search.best_path(f);
+
+            return long(f.edges().size());
+        });
+    }
+
+    {
+        ifst::fst f = make_chain(20000, 4, 7, 50, gen);
+        std::vector<int> order = fst::topo_order(f);
+
+        run("forward_k_best", "chain", f, [&]() {
+            fst::forward_k_best<ifst::fst> k_best;
+            k_best.first_best(f, order);
+
+            int final = f.finals().front();
+
+            for (int k = 1; k < 20; ++k) {
+                k_best.next_best(f, final, k);
+                k_best.best_path(f, final, k);
+            }
+
+            return long(f.edges().size());
+        });
+    }
+
+    {
+        ifst::fst f = make_cyclic(100000, 400000, gen);
+
+        run("topo_order", "cyclic", f, [&]() {
+            fst::topo_order(f);
+            return long(f.edges().size());
+        });
+
+        run("shortest_path", "cyclic", f, [&]() {
+            fst::shortest_path(f);
+            return long(f.edges().size());
+        });
+    }
+
+    {
+        ifst::fst lattice = make_chain(300, 3, 5, 40, gen);
+        ifst::fst lexicon = make_lexicon(2000, 6, 40, gen);
+
+        run_sized("compose_mode1", "lexicon", [&]() {
+            fst::lazy_pair_mode1_fst<ifst::fst, ifst::fst> composed { lattice, lexicon };
+            return expand(composed);
+        });
+
+        run_sized("compose_mode2", "lexicon", [&]() {
+            fst::lazy_pair_mode2_fst<ifst::fst, ifst::fst> composed { lattice, lexicon };
+            return expand(composed);
+        });
+    }
+
+    {
+        ifst::fst lattice = make_chain(300, 3, 5, 40, gen);
+        ifst::fst lexicon = make_lexicon(2000, 6, 40, gen, 0.2);
+
+        // Eps loops on the lattice, through the view and by copying the
+        // lattice and adding them.  The eps inputs of the lexicon are
+        // matched by the loops.
+
+        run_sized("compose_eps_loop_view", "lexicon_eps", [&]() {
+            ifst::eps_loop_fst looped { lattice };
+            fst::lazy_pair_mode1_fst<ifst::eps_loop_fst, ifst::fst> composed { looped, lexicon };
+            return expand(composed);
+        });
+
+        run_sized("compose_eps_loop_copy", "lexicon_eps", [&]() {
+            ifst::fst looped;
+            looped.data = std::make_shared<ifst::fst_data>(*lattice.data);
+            ifst::add_eps_loops(looped);
+            fst::lazy_pair_mode1_fst<ifst::fst, ifst::fst> composed { looped, lexicon };
+            return expand(composed);
+        });
+    }
+
+    return 0;
+}
@@ -3,6 +3,10 @@ namespace fst {
     template <class fst>
     std::vector<typename fst::vertex> topo_order(fst const& f)
     {
+#if FST_TRACE
+        scoped_trace trace_scope { "topo_order", { "vertices", "edges" } };
+#endif
+
         enum class action_t {
             color_grey,
             color_black
@@ -30,9 +34,17 @@ namespace fst {
 
                 traversed.insert(v);
 
+#if FST_TRACE
+                ++trace_scope.counts(0);
+#endif
+
                 stack.push_back(std::make_pair(action_t::color_black, v));
 
                 for (auto& e: f.out_edges(v)) {
+#if FST_TRACE
+                    ++trace_scope.counts(1);
+#endif
+
                     auto u = f.head(e);
 
                     if (!ebt::in(u, traversed)) {
@@ -53,51 +65,67 @@ namespace fst {
         return order;
     }
 
-    template <class fst>
-    void forward_one_best<fst>::merge(fst const& f, std::vector<typename fst::vertex> const& order)
+    template <class fst, class semiring, class direction>
+    void path_sum<fst, semiring, direction>::merge(fst const& f,
+        std::vector<typename fst::vertex> const& order)
     {
-        double inf = std::numeric_limits<double>::infinity();
-
-        auto get_value = [&](vertex v) {
-            if (!ebt::in(v, extra)) {
-                return -inf;
-            } else {
-                return extra.at(v).value;
-            }
-        };
+#if FST_TRACE
+        scoped_trace trace_scope { "path_sum::merge", { "vertices", "edges_relaxed" } };
+#endif
 
         for (auto& u: order) {
-            double max = get_value(u);
-            typename fst::edge argmax;
-            bool update = false;
+            auto& edges = direction::edges(f, u);
 
-            std::vector<edge> edges = f.in_edges(u);
-            std::vector<double> candidate_value;
-            candidate_value.resize(edges.size());
+            candidates.resize(edges.size() + 1);
 
-            for (int i = 0; i < edges.size(); ++i) {
-                typename fst::edge& e = edges[i];
-                typename fst::vertex v = f.tail(e);
-                candidate_value[i] = get_value(v) + f.weight(e);
-            }
+            auto u_iter = extra.find(u);
+            candidates[0] = (u_iter == extra.end() ? semiring::zero() : u_iter->second);
+            int n = 1;
 
-            for (int i = 0; i < edges.size(); ++i) {
-                if (candidate_value[i] > max) {
-                    max = candidate_value[i];
-                    argmax = edges[i];
-                    update = true;
+            for (auto& e: edges) {
+                auto v_iter = extra.find(direction::other(f, e));
+
+                if (v_iter == extra.end()) {
+                    continue;
                 }
+
+                candidates[n] = semiring::times(v_iter->second, semiring::edge_value(f, e));
+                ++n;
             }
 
-            if (update) {
-                extra[u] = extra_data { argmax, max };
+            // A vertex that is not reached stays out of `extra`.
+            if (n > 1) {
+                extra[u] = semiring::sum(candidates.data(), n);
             }
+
+#if FST_TRACE
+            ++trace_scope.counts(0);
+            trace_scope.counts(1) += n - 1;
+#endif
         }
     }
 
+    template <class fst>
+    void forward_one_best<fst>::merge(fst const& f, std::vector<typename fst::vertex> const& order)
+    {
+#if FST_TRACE
+        scoped_trace trace_scope { "forward_one_best::merge" };
+#endif
+
+        path_sum<fst, viterbi_semiring<edge>, forward_direction> sum;
+
+        sum.extra.swap(extra);
+        sum.merge(f, order);
+        extra.swap(sum.extra);
+    }
+
     template <class fst>
     std::vector<typename fst::edge> forward_one_best<fst>::best_path(fst const& f)
     {
+#if FST_TRACE
+        scoped_trace trace_scope { "forward_one_best::best_path", { "edges" } };
+#endif
+
         double inf = std::numeric_limits<double>::infinity();
         double max = -inf;
         typename fst::vertex argmax;
@@ -124,6 +152,11 @@ namespace fst {
             edge e = extra.at(u).pi;
             vertex v = f.tail(e);
             result.push_back(e);
+
+#if FST_TRACE
+            ++trace_scope.counts(0);
+#endif
+
             u = v;
         }
 
@@ -135,51 +168,27 @@ namespace fst {
     template <class fst>
     void backward_one_best<fst>::merge(fst const& f, std::vector<typename fst::vertex> const& order)
     {
-        double inf = std::numeric_limits<double>::infinity();
-
-        auto get_value = [&](vertex v) {
-            if (!ebt::in(v, extra)) {
-                return -inf;
-            } else {
-                return extra.at(v).value;
-            }
-        };
+#if FST_TRACE
+        scoped_trace trace_scope { "backward_one_best::merge" };
+#endif
 
         auto rev_order = order;
         std::reverse(rev_order.begin(), rev_order.end());
 
-        for (auto& u: rev_order) {
-            double max = get_value(u);
-            typename fst::edge argmax;
-            bool update = false;
-
-            std::vector<edge> edges = f.out_edges(u);
-            std::vector<double> candidate_value;
-            candidate_value.resize(edges.size());
+        path_sum<fst, viterbi_semiring<edge>, backward_direction> sum;
 
-            for (int i = 0; i < edges.size(); ++i) {
-                typename fst::edge& e = edges[i];
-                typename fst::vertex v = f.head(e);
-                candidate_value[i] = get_value(v) + f.weight(e);
-            }
-
-            for (int i = 0; i < edges.size(); ++i) {
-                if (candidate_value[i] > max) {
-                    max = candidate_value[i];
-                    argmax = edges[i];
-                    update = true;
-                }
-            }
-
-            if (update) {
-                extra[u] = extra_data { argmax, max };
-            }
-        }
+        sum.extra.swap(extra);
+        sum.merge(f, rev_order);
+        extra.swap(sum.extra);
     }
 
     template <class fst>
     std::vector<typename fst::edge> backward_one_best<fst>::best_path(fst const& f)
     {
+#if FST_TRACE
+        scoped_trace trace_scope { "backward_one_best::best_path", { "edges" } };
+#endif
+
         double inf = std::numeric_limits<double>::infinity();
         double max = -inf;
         typename fst::vertex argmax;
@@ -206,6 +215,11 @@ namespace fst {
             edge e = extra.at(u).pi;
             vertex v = f.head(e);
             result.push_back(e);
+
+#if FST_TRACE
+            ++trace_scope.counts(0);
+#endif
+
             u = v;
         }
 
@@ -220,9 +234,15 @@ namespace fst {
         // 
         // When extra[v].deck.size() == 0, v is a deadend.
 
+#if FST_TRACE
+        scoped_trace trace_scope { "forward_k_best::first_best", { "vertices", "edges_relaxed" } };
+#endif
+
+        // An initial vertex with in-edges gets cards for the paths
+        // through it after its null card, so it only bottoms out below
+        // when it has no in-edges.
         for (auto& v: f.initials()) {
             vertex_extra[v].deck.push_back(std::make_tuple(edge_trait<typename fst::edge>::null, -1, 0));
-            vertex_extra[v].bottom_out = true;
         }
 
         for (auto& v: order) {
@@ -231,11 +251,19 @@ namespace fst {
             typename fst::edge argmax = edge_trait<typename fst::edge>::null;
             double max = -std::numeric_limits<double>::infinity();
 
+#if FST_TRACE
+            ++trace_scope.counts(0);
+#endif
+
             for (auto& e: in_edges) {
                 if (vertex_extra[f.tail(e)].deck.size() == 0) {
                     continue;
                 }
 
+#if FST_TRACE
+                ++trace_scope.counts(1);
+#endif
+
                 double value = f.weight(e) + std::get<2>(vertex_extra[f.tail(e)].deck[0]);
 
                 if (value > max) {
@@ -256,6 +284,10 @@ namespace fst {
     template <class fst>
     void forward_k_best<fst>::next_best(fst const& f, typename fst::vertex const& final, int k)
     {
+#if FST_TRACE
+        scoped_trace trace_scope { "forward_k_best::next_best", { "pops", "edges_relaxed" } };
+#endif
+
         std::vector<typename fst::vertex> stack;
 
         typename fst::vertex v = final;
@@ -278,12 +310,16 @@ namespace fst {
             int i = std::get<1>(vertex_extra[v].deck[m - 1]);
             typename fst::vertex tail = f.tail(e);
 
+            // Only descend when the tail has to make its next card;
+            // if it already has it, or has none left, `v` picks its
+            // next card from what is there.
             if (vertex_extra[tail].deck.size() == 0) {
                 break;
-            } else if (i == vertex_extra[tail].deck.size() - 1 && vertex_extra[tail].bottom_out) {
+            } else if (i < vertex_extra[tail].deck.size() - 1
+                    || vertex_extra[tail].bottom_out) {
                 stack.push_back(v);
                 break;
-            } else if (i <= vertex_extra[tail].deck.size() - 1) {
+            } else {
                 stack.push_back(v);
                 v = tail;
                 m = i + 1;
@@ -302,6 +338,10 @@ namespace fst {
             v = stack.back();
             stack.pop_back();
 
+#if FST_TRACE
+            ++trace_scope.counts(0);
+#endif
+
             typename fst::edge argmax = edge_trait<typename fst::edge>::null;
             double max = -std::numeric_limits<double>::infinity();
 
@@ -315,6 +355,10 @@ namespace fst {
                     continue;
                 }
 
+#if FST_TRACE
+                ++trace_scope.counts(1);
+#endif
+
                 double value = f.weight(e) + std::get<2>(vertex_extra[f.tail(e)].deck[get_top(e) + 1]);
 
                 if (value > max) {
@@ -338,18 +382,32 @@ namespace fst {
     std::vector<typename fst::edge> forward_k_best<fst>::best_path(
         fst const& f, typename fst::vertex const& final, int k)
     {
+#if FST_TRACE
+        scoped_trace trace_scope { "forward_k_best::best_path", { "edges" } };
+#endif
+
         std::vector<typename fst::edge> result;
 
         vertex u = final;
         int i = k;
 
-        std::vector<typename fst::vertex> const& initials = f.initials();
-        std::unordered_set<typename fst::vertex> initial_set { initials.begin(), initials.end() };
-
-        while (!ebt::in(u, initial_set)) {
+        // Follow the cards rather than stop at the first initial vertex.
+        // An initial vertex with in-edges has paths through it below its
+        // null card.
+        while (1) {
             edge e = std::get<0>(vertex_extra.at(u).deck[i]);
+
+            if (e == edge_trait<typename fst::edge>::null) {
+                break;
+            }
+
             i = std::get<1>(vertex_extra.at(u).deck[i]);
             result.push_back(e);
+
+#if FST_TRACE
+            ++trace_scope.counts(0);
+#endif
+
             u = f.tail(e);
         }
 
@@ -358,14 +416,19 @@ namespace fst {
         return result;
     }
 
-    template <class fst>
-    void forward_log_sum<fst>::merge(fst const& f, std::vector<typename fst::vertex> const& order)
+    template <class fst, class log_add_type>
+    void forward_log_sum<fst, log_add_type>::merge(fst const& f, std::vector<typename fst::vertex> const& order)
     {
+#if FST_TRACE
+        scoped_trace trace_scope { "forward_log_sum::merge" };
+#endif
+
         for (auto& v: f.initials()) {
             extra[v] = 0;
         }
 
-        double inf = std::numeric_limits<double>::infinity();
+#if OMP_SAFE
+        value_type inf = std::numeric_limits<value_type>::infinity();
 
         auto get_value = [&](vertex v) {
             if (!ebt::in(v, extra)) {
@@ -376,8 +439,7 @@ namespace fst {
         };
 
         for (auto& u: order) {
-#if OMP_SAFE
-            double u_value = get_value(u);
+            value_type u_value = get_value(u);
 
             if (u_value == -inf) {
                 continue;
@@ -390,7 +452,7 @@ namespace fst {
                 for (int i = 0; i < p.second.size(); ++i) {
                     auto e = p.second[i];
                     vertex v = f.head(e);
-                    double s = get_value(v);
+                    value_type s = get_value(v);
                     extra[v] = s;
                 }
 
@@ -398,43 +460,33 @@ namespace fst {
                 for (int i = 0; i < p.second.size(); ++i) {
                     auto e = p.second[i];
                     vertex v = f.head(e);
-                    double s = ebt::log_add(get_value(v), u_value + f.weight(e));
+                    value_type s = log_add_type::log_add(get_value(v), u_value + f.weight(e));
                     extra.at(v) = s;
                 }
             }
+        }
 #else
-            double s = get_value(u);
-
-            std::vector<edge> edges = f.in_edges(u);
-            std::vector<double> candidate_value;
-            candidate_value.resize(edges.size());
-
-            for (int i = 0; i < edges.size(); ++i) {
-                edge& e = edges[i];
-                vertex v = f.tail(e);
-                candidate_value[i] = get_value(v) + f.weight(e);
-            }
-
-            for (int i = 0; i < edges.size(); ++i) {
-                if (candidate_value[i] != -inf) {
-                    s = ebt::log_add(s, candidate_value[i]);
-                }
-            }
-
-            extra[u] = s;
+        path_sum<fst, basic_log_semiring<log_add_type>, forward_direction> sum;
 
+        sum.extra.swap(extra);
+        sum.merge(f, order);
+        extra.swap(sum.extra);
 #endif
-        }
     }
 
-    template <class fst>
-    void backward_log_sum<fst>::merge(fst const& f, std::vector<typename fst::vertex> const& order)
+    template <class fst, class log_add_type>
+    void backward_log_sum<fst, log_add_type>::merge(fst const& f, std::vector<typename fst::vertex> const& order)
     {
+#if FST_TRACE
+        scoped_trace trace_scope { "backward_log_sum::merge" };
+#endif
+
         for (auto& v: f.finals()) {
             extra[v] = 0;
         }
 
-        double inf = std::numeric_limits<double>::infinity();
+#if OMP_SAFE
+        value_type inf = std::numeric_limits<value_type>::infinity();
 
         auto get_value = [&](vertex v) {
             if (!ebt::in(v, extra)) {
@@ -445,8 +497,7 @@ namespace fst {
         };
 
         for (auto& u: order) {
-#if OMP_SAFE
-            double u_value = get_value(u);
+            value_type u_value = get_value(u);
 
             if (u_value == -inf) {
                 continue;
@@ -459,7 +510,7 @@ namespace fst {
                 for (int i = 0; i < p.second.size(); ++i) {
                     auto e = p.second[i];
                     vertex v = f.tail(e);
-                    double s = get_value(v);
+                    value_type s = get_value(v);
                     extra[v] = s;
                 }
 
@@ -467,32 +518,18 @@ namespace fst {
                 for (int i = 0; i < p.second.size(); ++i) {
                     auto e = p.second[i];
                     vertex v = f.tail(e);
-                    double s = ebt::log_add(get_value(v), u_value + f.weight(e));
+                    value_type s = log_add_type::log_add(get_value(v), u_value + f.weight(e));
                     extra.at(v) = s;
                 }
             }
+        }
 #else
-            double s = get_value(u);
-
-            std::vector<edge> edges = f.out_edges(u);
-            std::vector<double> candidate_value;
-            candidate_value.resize(edges.size());
-
-            for (int i = 0; i < edges.size(); ++i) {
-                typename fst::edge& e = edges[i];
-                typename fst::vertex v = f.head(e);
-                candidate_value[i] = get_value(v) + f.weight(e);
-            }
+        path_sum<fst, basic_log_semiring<log_add_type>, backward_direction> sum;
 
-            for (int i = 0; i < edges.size(); ++i) {
-                if (candidate_value[i] != -inf) {
-                    s = ebt::log_add(s, candidate_value[i]);
-                }
-            }
-
-            extra[u] = s;
+        sum.extra.swap(extra);
+        sum.merge(f, order);
+        extra.swap(sum.extra);
 #endif
-        }
     }
 
     template <class fst_type>
@@ -514,6 +551,10 @@ namespace fst {
         std::vector<typename fst_type::vertex> const& order,
         double alpha, int min_edges)
     {
+#if FST_TRACE
+        scoped_trace trace_scope { "beam_prune::merge", { "vertices", "edges_relaxed", "edges_cut" } };
+#endif
+
         for (auto& v: f.initials()) {
             extra[v] = 0;
         }
@@ -531,6 +572,10 @@ namespace fst {
 
             auto edges = f.in_edges(v);
 
+#if FST_TRACE
+            ++trace_scope.counts(0);
+#endif
+
             if (edges.size() >= min_edges) {
                 for (auto& e: edges) {
                     double d = extra.at(f.tail(e));
@@ -552,6 +597,10 @@ namespace fst {
             for (auto& e: edges) {
                 double d = extra.at(f.tail(e));
 
+#if FST_TRACE
+                ++trace_scope.counts(d > cutoff ? 1 : 2);
+#endif
+
                 if (d > cutoff) {
                     retained_edges.push_back(e);
 
@@ -574,6 +623,10 @@ namespace fst {
         std::vector<typename fst_type::vertex> const& order,
         double alpha, int min_edges)
     {
+#if FST_TRACE
+        scoped_trace trace_scope { "beam_search::merge", { "vertices", "edges_relaxed", "edges_cut" } };
+#endif
+
         double inf = std::numeric_limits<double>::infinity();
 
         for (auto& v: order) {
@@ -587,8 +640,16 @@ namespace fst {
 
             auto edges = f.in_edges(v);
 
+#if FST_TRACE
+            ++trace_scope.counts(0);
+#endif
+
             if (edges.size() >= min_edges) {
                 for (auto& e: edges) {
+                    if (!ebt::in(f.tail(e), extra)) {
+                        continue;
+                    }
+
                     double d = extra.at(f.tail(e)).value;
 
                     if (d > max) {
@@ -606,8 +667,17 @@ namespace fst {
             }
 
             for (auto& e: edges) {
+                // The tail has no entry if all of its in-edges were pruned.
+                if (!ebt::in(f.tail(e), extra)) {
+                    continue;
+                }
+
                 double d = extra.at(f.tail(e)).value;
 
+#if FST_TRACE
+                ++trace_scope.counts(d > cutoff ? 1 : 2);
+#endif
+
                 if (d > cutoff) {
                     double candidate = d + f.weight(e);
 
@@ -629,6 +699,10 @@ namespace fst {
     template <class fst_type>
     std::vector<typename fst_type::edge> beam_search<fst_type>::best_path(fst_type const& f)
     {
+#if FST_TRACE
+        scoped_trace trace_scope { "beam_search::best_path", { "edges" } };
+#endif
+
         double inf = std::numeric_limits<double>::infinity();
         double max = -inf;
         vertex argmax;
@@ -655,6 +729,11 @@ namespace fst {
             edge e = extra.at(u).pi;
             vertex v = f.tail(e);
             result.push_back(e);
+
+#if FST_TRACE
+            ++trace_scope.counts(0);
+#endif
+
             u = v;
         }
 
@@ -663,5 +742,492 @@ namespace fst {
         return result;
     }
 
+    template <class fst>
+    void shortest_distance<fst>::merge(fst const& f, queue_discipline q)
+    {
+#if FST_TRACE
+        scoped_trace trace_scope { "shortest_distance::merge", { "pops", "edges_relaxed" } };
+#endif
+
+        double inf = std::numeric_limits<double>::infinity();
+
+        auto get_value = [&](vertex v) {
+            if (!ebt::in(v, extra)) {
+                return -inf;
+            } else {
+                return extra.at(v).value;
+            }
+        };
+
+        std::unordered_map<vertex, int> rank;
+
+        if (q == queue_discipline::top_order) {
+            std::vector<vertex> order = topo_order(f);
+
+            for (int i = 0; i < order.size(); ++i) {
+                rank[order[i]] = i;
+            }
+        }
+
+        // fifo and lifo use the deque.  priority and top_order use the heap,
+        // keyed by the negated value or by the rank, smallest key first.
+
+        std::deque<vertex> queue;
+
+        using key_vertex = std::pair<double, vertex>;
+        auto greater = [](key_vertex const& a, key_vertex const& b) {
+            return a.first > b.first;
+        };
+        std::priority_queue<key_vertex, std::vector<key_vertex>, decltype(greater)> heap { greater };
+
+        std::unordered_set<vertex> queued;
+
+        auto push = [&](vertex v) {
+            if (q == queue_discipline::fifo || q == queue_discipline::lifo) {
+                if (!ebt::in(v, queued)) {
+                    queue.push_back(v);
+                }
+            } else if (q == queue_discipline::priority) {
+                heap.push(std::make_pair(-get_value(v), v));
+            } else if (!ebt::in(v, queued)) {
+                heap.push(std::make_pair(double(rank.at(v)), v));
+            }
+
+            queued.insert(v);
+        };
+
+        auto pop = [&]() {
+            vertex v;
+
+            if (q == queue_discipline::fifo) {
+                v = queue.front();
+                queue.pop_front();
+            } else if (q == queue_discipline::lifo) {
+                v = queue.back();
+                queue.pop_back();
+            } else {
+                v = heap.top().second;
+                heap.pop();
+            }
+
+            return v;
+        };
+
+        for (auto& v: f.initials()) {
+            extra[v] = extra_data { edge_trait<edge>::null, 0 };
+            push(v);
+        }
+
+        while (queue.size() > 0 || heap.size() > 0) {
+            vertex u = pop();
+
+            // With the priority discipline, a vertex whose value improved
+            // while queued leaves a stale heap entry behind.  The entry
+            // with the better key is popped first, and the stale one is
+            // skipped here.
+            if (!ebt::in(u, queued)) {
+                continue;
+            }
+
+            queued.erase(u);
+
+#if FST_TRACE
+            ++trace_scope.counts(0);
+#endif
+
+            double u_value = get_value(u);
+
+            for (auto& e: f.out_edges(u)) {
+#if FST_TRACE
+                ++trace_scope.counts(1);
+#endif
+
+                vertex v = f.head(e);
+                double candidate = u_value + f.weight(e);
+
+                if (candidate > get_value(v)) {
+                    extra[v] = extra_data { e, candidate };
+                    push(v);
+                }
+            }
+        }
+    }
+
+    template <class fst>
+    std::vector<typename fst::edge> shortest_distance<fst>::best_path(fst const& f)
+    {
+#if FST_TRACE
+        scoped_trace trace_scope { "shortest_distance::best_path", { "edges" } };
+#endif
+
+        double inf = std::numeric_limits<double>::infinity();
+        double max = -inf;
+        vertex argmax;
+
+        for (auto v: f.finals()) {
+            if (ebt::in(v, extra) && extra.at(v).value > max) {
+                max = extra.at(v).value;
+                argmax = v;
+            }
+        }
+
+        std::vector<edge> result;
+
+        if (max == -inf) {
+            return result;
+        }
+
+        vertex u = argmax;
+
+        std::vector<vertex> const& initials = f.initials();
+        std::unordered_set<vertex> initial_set { initials.begin(), initials.end() };
+
+        while (!ebt::in(u, initial_set)) {
+            edge e = extra.at(u).pi;
+            result.push_back(e);
+
+#if FST_TRACE
+            ++trace_scope.counts(0);
+#endif
+
+            u = f.tail(e);
+        }
+
+        std::reverse(result.begin(), result.end());
+
+        return result;
+    }
+
+    template <class fst>
+    void a_star<fst>::merge(fst const& f)
+    {
+        merge(f, [](vertex const&) { return 0.0; });
+    }
+
+    template <class fst>
+    template <class heuristic>
+    void a_star<fst>::merge(fst const& f, heuristic h)
+    {
+#if FST_TRACE
+        scoped_trace trace_scope { "a_star::merge", { "pops", "edges_relaxed" } };
+#endif
+
+        double inf = std::numeric_limits<double>::infinity();
+
+        auto get_value = [&](vertex v) {
+            if (!ebt::in(v, extra)) {
+                return -inf;
+            } else {
+                return extra.at(v).value;
+            }
+        };
+
+        extra.clear();
+        found = false;
+
+        std::vector<vertex> const& finals = f.finals();
+        std::unordered_set<vertex> final_set { finals.begin(), finals.end() };
+
+        using key_vertex = std::pair<double, vertex>;
+        auto less = [](key_vertex const& a, key_vertex const& b) {
+            return a.first < b.first;
+        };
+        std::priority_queue<key_vertex, std::vector<key_vertex>, decltype(less)> heap { less };
+
+        for (auto& v: f.initials()) {
+            double hv = h(v);
+
+            if (hv == -inf) {
+                continue;
+            }
+
+            extra[v] = extra_data { edge_trait<edge>::null, 0 };
+            heap.push(std::make_pair(hv, v));
+        }
+
+        while (heap.size() > 0) {
+            double key = heap.top().first;
+            vertex u = heap.top().second;
+            heap.pop();
+
+            // Every improvement pushes a new entry, so an entry whose key
+            // is below the current value of its vertex is stale.  A vertex
+            // that improves after being expanded is pushed and expanded
+            // again, which keeps the result exact when the heuristic is
+            // admissible but not consistent.
+            double u_value = get_value(u);
+
+            if (key < u_value + h(u)) {
+                continue;
+            }
+
+#if FST_TRACE
+            ++trace_scope.counts(0);
+#endif
+
+            if (ebt::in(u, final_set)) {
+                found = true;
+                best_final = u;
+                return;
+            }
+
+            for (auto& e: f.out_edges(u)) {
+                vertex v = f.head(e);
+
+                double hv = h(v);
+
+                if (hv == -inf) {
+                    continue;
+                }
+
+#if FST_TRACE
+                ++trace_scope.counts(1);
+#endif
+
+                double candidate = u_value + f.weight(e);
+
+                if (candidate > get_value(v)) {
+                    extra[v] = extra_data { e, candidate };
+                    heap.push(std::make_pair(candidate + hv, v));
+                }
+            }
+        }
+    }
+
+    template <class fst>
+    std::vector<typename fst::edge> a_star<fst>::best_path(fst const& f)
+    {
+#if FST_TRACE
+        scoped_trace trace_scope { "a_star::best_path", { "edges" } };
+#endif
+
+        std::vector<edge> result;
+
+        if (!found) {
+            return result;
+        }
+
+        vertex u = best_final;
+
+        std::vector<vertex> const& initials = f.initials();
+        std::unordered_set<vertex> initial_set { initials.begin(), initials.end() };
+
+        while (!ebt::in(u, initial_set)) {
+            edge e = extra.at(u).pi;
+            result.push_back(e);
+
+#if FST_TRACE
+            ++trace_scope.counts(0);
+#endif
+
+            u = f.tail(e);
+        }
+
+        std::reverse(result.begin(), result.end());
+
+        return result;
+    }
+
+    template <class fst_type>
+    std::vector<typename fst_type::edge> shortest_path(fst_type const& f)
+    {
+        shortest_distance<fst_type> dist;
+        dist.merge(f, queue_discipline::priority);
+
+        return dist.best_path(f);
+    }
+
+    template <class fst_type>
+    void token_passing<fst_type>::add_token(long t, token const& tok)
+    {
+        auto iter = active.find(t);
+
+        if (iter == active.end()) {
+            if (free_lists.size() > 0) {
+                iter = active.emplace(t, std::move(free_lists.back())).first;
+                free_lists.pop_back();
+            } else {
+                iter = active.emplace(t, token_list {}).first;
+            }
+
+            iter->second.expanded = 0;
+        }
+
+        token_list& list = iter->second;
+
+        auto index_iter = list.index.find(tok.v);
+
+        if (index_iter == list.index.end()) {
+            list.index[tok.v] = list.tokens.size();
+            list.tokens.push_back(tok);
+        } else if (tok.value > list.tokens[index_iter->second].value) {
+            if (index_iter->second < list.expanded) {
+                // The old token has been expanded already, so the better
+                // one is appended to be expanded again.
+                index_iter->second = list.tokens.size();
+                list.tokens.push_back(tok);
+            } else {
+                list.tokens[index_iter->second] = tok;
+            }
+        }
+    }
+
+    template <class fst_type>
+    void token_passing<fst_type>::prune(token_list& list,
+        double beam, int max_active, double& cutoff)
+    {
+        double max = -std::numeric_limits<double>::infinity();
+
+        for (auto& tok: list.tokens) {
+            if (tok.value > max) {
+                max = tok.value;
+            }
+        }
+
+        cutoff = max - beam;
+
+        int size = 0;
+
+        for (int i = 0; i < list.tokens.size(); ++i) {
+            if (list.tokens[i].value >= cutoff) {
+                list.tokens[size] = list.tokens[i];
+                ++size;
+            }
+        }
+
+        list.tokens.resize(size);
+
+        if (max_active > 0 && size > max_active) {
+            std::nth_element(list.tokens.begin(), list.tokens.begin() + max_active - 1,
+                list.tokens.end(), [](token const& t1, token const& t2) {
+                    return t1.value > t2.value;
+                });
+
+            cutoff = std::max(cutoff, list.tokens[max_active - 1].value);
+            list.tokens.resize(max_active);
+        }
+
+        list.index.clear();
+
+        for (int i = 0; i < list.tokens.size(); ++i) {
+            list.index[list.tokens[i].v] = i;
+        }
+    }
+
+    template <class fst_type>
+    void token_passing<fst_type>::merge(fst_type const& f,
+        double beam, int max_active)
+    {
+        merge(f, beam, max_active, [&](vertex const& v) { return f.time(v); });
+    }
+
+    template <class fst_type>
+    template <class time_fn>
+    void token_passing<fst_type>::merge(fst_type const& f,
+        double beam, int max_active, time_fn time)
+    {
+#if FST_TRACE
+        scoped_trace trace_scope { "token_passing::merge",
+            { "tokens_expanded", "edges_relaxed", "tokens_cut" } };
+#endif
+
+        trace.clear();
+        found = false;
+
+        std::vector<vertex> const& finals = f.finals();
+        std::unordered_set<vertex> final_set { finals.begin(), finals.end() };
+
+        for (auto& v: f.initials()) {
+            add_token(time(v), token { v, 0, edge_trait<edge>::null, -1 });
+        }
+
+        while (active.size() > 0) {
+            auto iter = active.begin();
+            long t = iter->first;
+            token_list& list = iter->second;
+
+#if FST_TRACE
+            trace_scope.counts(2) += list.tokens.size();
+#endif
+
+            double cutoff;
+            prune(list, beam, max_active, cutoff);
+
+#if FST_TRACE
+            trace_scope.counts(2) -= list.tokens.size();
+#endif
+
+            // Tokens of the same time can still be appended while expanding.
+            for (; list.expanded < list.tokens.size(); ++list.expanded) {
+                token tok = list.tokens[list.expanded];
+
+                if (tok.value < cutoff || list.index.at(tok.v) != list.expanded) {
+                    continue;
+                }
+
+                int id = trace.size();
+                trace.push_back(trace_data { tok.pi, tok.back });
+
+#if FST_TRACE
+                ++trace_scope.counts(0);
+#endif
+
+                if (ebt::in(tok.v, final_set) && (!found || tok.value > best_value)) {
+                    found = true;
+                    best_value = tok.value;
+                    best_trace = id;
+                }
+
+                for (auto& e: f.out_edges(tok.v)) {
+#if FST_TRACE
+                    ++trace_scope.counts(1);
+#endif
+
+                    vertex u = f.head(e);
+                    long tu = time(u);
+
+                    if (tu < t) {
+                        std::cerr << "token_passing: edge goes back in time from "
+                            << t << " to " << tu << std::endl;
+                        exit(1);
+                    }
+
+                    add_token(tu, token { u, tok.value + f.weight(e), e, id });
+                }
+            }
+
+            list.tokens.clear();
+            list.index.clear();
+            free_lists.push_back(std::move(list));
+            active.erase(iter);
+        }
+    }
+
+    template <class fst_type>
+    std::vector<typename fst_type::edge> token_passing<fst_type>::best_path() const
+    {
+#if FST_TRACE
+        scoped_trace trace_scope { "token_passing::best_path", { "edges" } };
+#endif
+
+        std::vector<edge> result;
+
+        if (!found) {
+            return result;
+        }
+
+        for (int i = best_trace; trace[i].back != -1; i = trace[i].back) {
+            result.push_back(trace[i].e);
+
+#if FST_TRACE
+            ++trace_scope.counts(0);
+#endif
+        }
+
+        std::reverse(result.begin(), result.end());
+
+        return result;
+    }
+
 }
 
@@ -1,23 +1,55 @@
 #ifndef FST_ALGO_H
 #define FST_ALGO_H
 
+#include <deque>
+#include <map>
+#include <queue>
+#include <unordered_set>
 #include "fst/fst.h"
+#include "fst/fst-semiring.h"
+#include "fst/fst-trace.h"
 
 namespace fst {
 
     template <class fst>
     std::vector<typename fst::vertex> topo_order(fst const& f);
 
+    /*
+     * Adds up, in the semiring, the weights of all paths reaching each
+     * vertex, visiting vertices in `order`.  With `forward_direction`
+     * the paths start at vertices whose value is set before calling
+     * `merge` (usually the initials); with `backward_direction` they
+     * end at them (usually the finals), and `order` should be reversed.
+     * A vertex no path reaches gets no entry in `extra`.
+     *
+     * The semiring and direction are template parameters, so the inner
+     * loop is specialized at compile time, and all values reaching a
+     * vertex are summed with one call to `semiring::sum` on a buffer
+     * that is reused across vertices.
+     *
+     */
+    template <class fst, class semiring, class direction = forward_direction>
+    struct path_sum {
+
+        using vertex = typename fst::vertex;
+        using edge = typename fst::edge;
+        using value_type = typename semiring::value_type;
+
+        std::unordered_map<vertex, value_type> extra;
+
+        std::vector<value_type> candidates;
+
+        void merge(fst const& f, std::vector<vertex> const& order);
+
+    };
+
     template <class fst>
     struct forward_one_best {
 
         using vertex = typename fst::vertex;
         using edge = typename fst::edge;
 
-        struct extra_data {
-            edge pi;
-            double value;
-        };
+        using extra_data = typename viterbi_semiring<edge>::value_type;
 
         std::unordered_map<vertex, extra_data> extra;
 
@@ -33,10 +65,7 @@ namespace fst {
         using vertex = typename fst::vertex;
         using edge = typename fst::edge;
 
-        struct extra_data {
-            edge pi;
-            double value;
-        };
+        using extra_data = typename viterbi_semiring<edge>::value_type;
 
         std::unordered_map<vertex, extra_data> extra;
 
@@ -70,29 +99,38 @@ namespace fst {
 
     };
 
-    template <class fst>
+    /*
+     * `log_add_type` is one of the log-add implementations in
+     * `fst-semiring.h`, e.g., `table_log_add<>` to trade accuracy
+     * (within 1e-4) for speed.  Values are kept in its `value_type`,
+     * so `table_log_add<float>` halves the size of `extra`.
+     *
+     */
+    template <class fst, class log_add_type = exact_log_add<>>
     struct forward_log_sum {
 
         using vertex = typename fst::vertex;
         using edge = typename fst::edge;
         using input_symbol = typename fst::input_symbol;
         using output_symbol = typename fst::output_symbol;
+        using value_type = typename log_add_type::value_type;
 
-        std::unordered_map<vertex, double> extra;
+        std::unordered_map<vertex, value_type> extra;
 
         void merge(fst const& f, std::vector<vertex> const& order);
 
     };
 
-    template <class fst>
+    template <class fst, class log_add_type = exact_log_add<>>
     struct backward_log_sum {
 
         using vertex = typename fst::vertex;
         using edge = typename fst::edge;
         using input_symbol = typename fst::input_symbol;
         using output_symbol = typename fst::output_symbol;
+        using value_type = typename log_add_type::value_type;
 
-        std::unordered_map<vertex, double> extra;
+        std::unordered_map<vertex, value_type> extra;
 
         void merge(fst const& f, std::vector<vertex> const& order);
 
@@ -136,6 +174,164 @@ namespace fst {
         std::vector<edge> best_path(fst_type const& f);
     };
 
+    /*
+     * Queue disciplines for `shortest_distance`.
+     *
+     * `top_order` ranks vertices by their position in `topo_order`.
+     * On acyclic graphs every vertex is then relaxed once.  On cyclic
+     * graphs the order is only a DFS finishing order, but vertices are
+     * put back in the queue whenever their value improves, so the
+     * result is still correct.
+     *
+     */
+    enum class queue_discipline {
+        fifo,
+        lifo,
+        priority,
+        top_order
+    };
+
+    /*
+     * Single-source best distance (max-plus) that does not need a
+     * topological order and works on graphs with cycles, e.g., those
+     * with loops from `ifst::add_eps_loops`.  The graph must not have
+     * cycles with positive weight.
+     *
+     */
+    template <class fst>
+    struct shortest_distance {
+
+        using vertex = typename fst::vertex;
+        using edge = typename fst::edge;
+
+        struct extra_data {
+            edge pi;
+            double value;
+        };
+
+        std::unordered_map<vertex, extra_data> extra;
+
+        void merge(fst const& f, queue_discipline q = queue_discipline::priority);
+
+        std::vector<edge> best_path(fst const& f);
+
+    };
+
+    /*
+     * Best-first search that stops when the first final vertex is
+     * popped.  All edge weights must be non-positive (e.g., log
+     * probabilities).  Without a heuristic this is Dijkstra's algorithm.
+     *
+     * With a heuristic `h(v)` that never underestimates the best score
+     * from `v` to a final vertex, it becomes A*.  The backward scores of
+     * `backward_one_best` are such a heuristic.  Vertices with
+     * `h(v) == -inf` cannot reach a final vertex and are never expanded.
+     *
+     * A vertex whose score improves after it was expanded is expanded
+     * again, so the best path is found with any such heuristic.  This
+     * only happens if `h` is not consistent, i.e., if some edge `e`
+     * has `h(tail) < weight(e) + h(head)`; with the backward scores,
+     * every vertex is expanded at most once.  `merge` clears `extra`
+     * and `found` from a previous run.
+     *
+     */
+    template <class fst>
+    struct a_star {
+
+        using vertex = typename fst::vertex;
+        using edge = typename fst::edge;
+
+        struct extra_data {
+            edge pi;
+            double value;
+        };
+
+        std::unordered_map<vertex, extra_data> extra;
+
+        bool found = false;
+        vertex best_final;
+
+        void merge(fst const& f);
+
+        template <class heuristic>
+        void merge(fst const& f, heuristic h);
+
+        std::vector<edge> best_path(fst const& f);
+
+    };
+
+    template <class fst_type>
+    std::vector<typename fst_type::edge> shortest_path(fst_type const& f);
+
+    /*
+     * Time-synchronous token passing.
+     *
+     * Tokens are grouped by the time of their vertex and the groups are
+     * processed in increasing time.  Before a group is expanded, tokens
+     * worse than the best token of the group by more than `beam` are
+     * dropped, and if more than `max_active` tokens remain, only the
+     * best `max_active` are kept.  Only the out-edges of surviving
+     * tokens are visited, so a lazy composition expands active states
+     * only.  Edges between vertices of the same time (e.g., epsilons)
+     * are followed within the group, but must not form cycles of
+     * positive weight.  An edge whose head has an earlier time than its
+     * tail is an error.
+     *
+     * `time` maps a vertex to its time.  Without it, `f.time(v)` is
+     * used.  For a `lazy_pair_fst` over `ifst::fst`, one would pass
+     * `[&](vertex v) { return f.fst1().time(std::get<0>(v)); }`.
+     *
+     * Only tokens that survive pruning leave an entry in `trace`, and
+     * each entry is just the edge taken and the index of the previous
+     * entry.  Token storage is recycled from one time to the next.
+     *
+     */
+    template <class fst_type>
+    struct token_passing {
+
+        using vertex = typename fst_type::vertex;
+        using edge = typename fst_type::edge;
+
+        struct token {
+            vertex v;
+            double value;
+            edge pi;
+            int back;
+        };
+
+        struct trace_data {
+            edge e;
+            int back;
+        };
+
+        struct token_list {
+            std::vector<token> tokens;
+            std::unordered_map<vertex, int> index;
+            int expanded;
+        };
+
+        std::vector<trace_data> trace;
+
+        std::map<long, token_list> active;
+        std::vector<token_list> free_lists;
+
+        bool found = false;
+        double best_value;
+        int best_trace;
+
+        void merge(fst_type const& f, double beam, int max_active);
+
+        template <class time_fn>
+        void merge(fst_type const& f, double beam, int max_active, time_fn time);
+
+        std::vector<edge> best_path() const;
+
+        void add_token(long t, token const& tok);
+
+        void prune(token_list& list, double beam, int max_active, double& cutoff);
+
+    };
+
 }
 
 #include "fst/fst-algo-impl.h"
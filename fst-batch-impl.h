@@ -0,0 +1,89 @@
+namespace fst {
+
+    template <class scratch, class fst_type, class algo>
+    std::vector<typename std::result_of<algo(fst_type const&, scratch&)>::type>
+    batch_run(work_stealing_pool& pool, fst_type const *fsts, int size, algo a)
+    {
+        using result = typename std::result_of<algo(fst_type const&, scratch&)>::type;
+
+        std::vector<result> results;
+        results.resize(size);
+
+        std::vector<scratch> scratches;
+        scratches.resize(pool.size());
+
+        pool.run(size, [&](int w, int i) {
+            results[i] = a(fsts[i], scratches[w]);
+        });
+
+        return results;
+    }
+
+    template <class scratch, class fst_type, class algo>
+    std::vector<typename std::result_of<algo(fst_type const&, scratch&)>::type>
+    batch_run(work_stealing_pool& pool, std::vector<fst_type> const& fsts, algo a)
+    {
+        return batch_run<scratch>(pool, fsts.data(), fsts.size(), a);
+    }
+
+    template <class fst_type>
+    std::vector<std::vector<typename fst_type::edge>>
+    batch_shortest_path(work_stealing_pool& pool, std::vector<fst_type> const& fsts)
+    {
+        using edge = typename fst_type::edge;
+
+        return batch_run<forward_one_best<fst_type>>(pool, fsts,
+            [](fst_type const& f, forward_one_best<fst_type>& one_best) {
+                one_best.extra.clear();
+
+                for (auto& v: f.initials()) {
+                    one_best.extra[v] = { edge_trait<edge>::null, 0 };
+                }
+                one_best.merge(f, topo_order(f));
+
+                return one_best.best_path(f);
+            });
+    }
+
+    template <class fst_type>
+    std::vector<double>
+    batch_forward_log_sum(work_stealing_pool& pool, std::vector<fst_type> const& fsts)
+    {
+        return batch_run<forward_log_sum<fst_type>>(pool, fsts,
+            [](fst_type const& f, forward_log_sum<fst_type>& log_sum) {
+                log_sum.extra.clear();
+                log_sum.merge(f, topo_order(f));
+
+                double s = -std::numeric_limits<double>::infinity();
+
+                for (auto& v: f.finals()) {
+                    if (ebt::in(v, log_sum.extra)) {
+                        s = ebt::log_add(s, log_sum.extra.at(v));
+                    }
+                }
+
+                return s;
+            });
+    }
+
+    template <class fst_type>
+    std::vector<std::vector<typename fst_type::edge>>
+    batch_beam_search(work_stealing_pool& pool, std::vector<fst_type> const& fsts,
+        double alpha, int min_edges)
+    {
+        using edge = typename fst_type::edge;
+
+        return batch_run<beam_search<fst_type>>(pool, fsts,
+            [&](fst_type const& f, beam_search<fst_type>& search) {
+                search.extra.clear();
+
+                for (auto& v: f.initials()) {
+                    search.extra[v] = { edge_trait<edge>::null, 0 };
+                }
+                search.merge(f, topo_order(f), alpha, min_edges);
+
+                return search.best_path(f);
+            });
+    }
+
+}
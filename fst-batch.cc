@@ -0,0 +1,163 @@
+#include "fst/fst-batch.h"
+#include <algorithm>
+
+namespace fst {
+
+    work_stealing_pool::work_stealing_pool(int nthreads)
+        : task(nullptr), round(0), running(0), stop(false)
+    {
+        nthreads = std::max(nthreads, 1);
+
+        for (int w = 0; w < nthreads; ++w) {
+            queues.emplace_back(new worker_queue);
+        }
+
+        for (int w = 1; w < nthreads; ++w) {
+            threads.emplace_back([this, w]() { worker_loop(w); });
+        }
+    }
+
+    work_stealing_pool::~work_stealing_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock { mutex };
+            stop = true;
+        }
+
+        start_cv.notify_all();
+
+        for (auto& t: threads) {
+            t.join();
+        }
+    }
+
+    int work_stealing_pool::size() const
+    {
+        return queues.size();
+    }
+
+    void work_stealing_pool::run(int size, std::function<void(int, int)> const& task)
+    {
+        int nworkers = queues.size();
+
+        // Each worker starts with a contiguous block of items, cut into
+        // ranges small enough to balance the load by stealing.
+
+        int grain = std::max(1, size / (nworkers * 8));
+
+        for (int w = 0; w < nworkers; ++w) {
+            int begin = long(size) * w / nworkers;
+            int end = long(size) * (w + 1) / nworkers;
+
+            std::lock_guard<std::mutex> lock { queues[w]->mutex };
+
+            for (int i = end; i > begin; i -= grain) {
+                queues[w]->ranges.push_back(std::make_pair(std::max(begin, i - grain), i));
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock { mutex };
+            this->task = &task;
+            error = nullptr;
+            running = nworkers - 1;
+            ++round;
+        }
+
+        start_cv.notify_all();
+
+        work(0);
+
+        std::unique_lock<std::mutex> lock { mutex };
+        done_cv.wait(lock, [this]() { return running == 0; });
+
+        this->task = nullptr;
+
+        if (error != nullptr) {
+            std::exception_ptr e = error;
+            error = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+
+    void work_stealing_pool::worker_loop(int w)
+    {
+        long seen = 0;
+
+        while (1) {
+            {
+                std::unique_lock<std::mutex> lock { mutex };
+                start_cv.wait(lock, [&]() { return stop || round != seen; });
+
+                if (stop) {
+                    return;
+                }
+
+                seen = round;
+            }
+
+            work(w);
+
+            {
+                std::lock_guard<std::mutex> lock { mutex };
+                --running;
+            }
+
+            done_cv.notify_all();
+        }
+    }
+
+    void work_stealing_pool::work(int w)
+    {
+        std::pair<int, int> range;
+
+        while (take(w, range) || steal(w, range)) {
+            for (int i = range.first; i < range.second; ++i) {
+                try {
+                    (*task)(w, i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock { mutex };
+
+                    if (error == nullptr) {
+                        error = std::current_exception();
+                    }
+                }
+            }
+        }
+    }
+
+    bool work_stealing_pool::take(int w, std::pair<int, int>& range)
+    {
+        std::lock_guard<std::mutex> lock { queues[w]->mutex };
+
+        if (queues[w]->ranges.size() == 0) {
+            return false;
+        }
+
+        range = queues[w]->ranges.back();
+        queues[w]->ranges.pop_back();
+
+        return true;
+    }
+
+    bool work_stealing_pool::steal(int w, std::pair<int, int>& range)
+    {
+        int nworkers = queues.size();
+
+        for (int k = 1; k < nworkers; ++k) {
+            worker_queue& victim = *queues[(w + k) % nworkers];
+
+            std::lock_guard<std::mutex> lock { victim.mutex };
+
+            if (victim.ranges.size() > 0) {
+                range = victim.ranges.front();
+                victim.ranges.pop_front();
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+}
@@ -0,0 +1,108 @@
+#ifndef FST_BATCH_H
+#define FST_BATCH_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <type_traits>
+#include "fst/fst-algo.h"
+
+namespace fst {
+
+    /*
+     * A fixed set of workers, each owning a deque of item ranges.
+     * A worker takes ranges from the back of its own deque, and when
+     * that is empty, steals from the front of the others.
+     *
+     * The thread calling `run` works as worker 0, so a pool of size 1
+     * starts no threads.  Threads are kept alive between calls to `run`.
+     *
+     */
+    struct work_stealing_pool {
+
+        struct worker_queue {
+            std::mutex mutex;
+            std::deque<std::pair<int, int>> ranges;
+        };
+
+        std::vector<std::thread> threads;
+        std::vector<std::unique_ptr<worker_queue>> queues;
+
+        std::mutex mutex;
+        std::condition_variable start_cv;
+        std::condition_variable done_cv;
+
+        std::function<void(int, int)> const *task;
+        std::exception_ptr error;
+        long round;
+        int running;
+        bool stop;
+
+        work_stealing_pool(int nthreads = std::thread::hardware_concurrency());
+        ~work_stealing_pool();
+
+        work_stealing_pool(work_stealing_pool const&) = delete;
+        work_stealing_pool& operator=(work_stealing_pool const&) = delete;
+
+        int size() const;
+
+        /*
+         * Calls `task(worker, item)` for every item in [0, size) and
+         * returns when all are done.  The first exception thrown by a
+         * task is rethrown here.
+         *
+         */
+        void run(int size, std::function<void(int, int)> const& task);
+
+        void worker_loop(int w);
+        void work(int w);
+        bool take(int w, std::pair<int, int>& range);
+        bool steal(int w, std::pair<int, int>& range);
+
+    };
+
+    /*
+     * Runs `algo(f, s)` on each of the `size` fsts starting at `fsts`
+     * and returns the results in input order.
+     *
+     * Each worker owns one `scratch` object `s` and passes it to every
+     * item it processes, so hash maps and buffers kept there are reused
+     * from one fst to the next instead of being allocated per call.
+     *
+     */
+    template <class scratch, class fst_type, class algo>
+    std::vector<typename std::result_of<algo(fst_type const&, scratch&)>::type>
+    batch_run(work_stealing_pool& pool, fst_type const *fsts, int size, algo a);
+
+    template <class scratch, class fst_type, class algo>
+    std::vector<typename std::result_of<algo(fst_type const&, scratch&)>::type>
+    batch_run(work_stealing_pool& pool, std::vector<fst_type> const& fsts, algo a);
+
+    template <class fst_type>
+    std::vector<std::vector<typename fst_type::edge>>
+    batch_shortest_path(work_stealing_pool& pool, std::vector<fst_type> const& fsts);
+
+    /*
+     * The log sum over the final vertices of each fst, i.e., the total
+     * weight of all paths.
+     *
+     */
+    template <class fst_type>
+    std::vector<double>
+    batch_forward_log_sum(work_stealing_pool& pool, std::vector<fst_type> const& fsts);
+
+    template <class fst_type>
+    std::vector<std::vector<typename fst_type::edge>>
+    batch_beam_search(work_stealing_pool& pool, std::vector<fst_type> const& fsts,
+        double alpha, int min_edges);
+
+}
+
+#include "fst/fst-batch-impl.h"
+
+#endif
@@ -5,6 +5,49 @@ namespace fst {
         : fst1_(fst1), fst2_(fst2)
     {}
 
+#if FST_STATS
+    template <class fst1_type, class fst2_type>
+    pair_fst_stats lazy_pair_fst<fst1_type, fst2_type>::stats() const
+    {
+        pair_fst_stats result = stats_;
+
+        result.cache_bytes = pair_fst_stats::bytes(vertices_cache)
+            + pair_fst_stats::bytes(edges_cache)
+            + pair_fst_stats::bytes(initials_cache)
+            + pair_fst_stats::bytes(finals_cache)
+            + pair_fst_stats::bytes(in_edges_cache)
+            + pair_fst_stats::bytes(out_edges_cache)
+            + pair_fst_stats::bytes(in_edges_input_map_cache)
+            + pair_fst_stats::bytes(in_edges_output_map_cache)
+            + pair_fst_stats::bytes(out_edges_input_map_cache)
+            + pair_fst_stats::bytes(out_edges_output_map_cache)
+            + stats_vertices.size() * (sizeof(vertex) + 2 * sizeof(void*));
+
+        return result;
+    }
+
+    template <class fst1_type, class fst2_type>
+    void lazy_pair_fst<fst1_type, fst2_type>::reset_stats()
+    {
+        stats_ = pair_fst_stats {};
+        stats_vertices.clear();
+    }
+
+    template <class fst1_type, class fst2_type>
+    template <class container>
+    void lazy_pair_fst<fst1_type, fst2_type>::note_expanded(
+        typename lazy_pair_fst<fst1_type, fst2_type>::vertex const& v,
+        container const& result) const
+    {
+        stats_.expanded(result);
+
+        if (!ebt::in(v, stats_vertices)) {
+            stats_vertices.insert(v);
+            ++stats_.states_expanded;
+        }
+    }
+#endif
+
     template <class fst1_type, class fst2_type>
     std::vector<typename lazy_pair_fst<fst1_type, fst2_type>::vertex> const&
     lazy_pair_fst<fst1_type, fst2_type>::vertices() const
@@ -68,6 +111,11 @@ namespace fst {
     lazy_pair_fst<fst1_type, fst2_type>::in_edges(
         typename lazy_pair_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::in_edges,
+            this->in_edges_cache != nullptr && *this->in_edges_vertex == v);
+#endif
+
         if (in_edges_cache == nullptr || *in_edges_vertex != v) {
             std::vector<typename lazy_pair_fst<fst1_type, fst2_type>::edge> in_edges;
 
@@ -82,6 +130,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, in_edges);
+#endif
+
             in_edges_vertex = std::make_shared<
                 typename lazy_pair_fst<fst1_type, fst2_type>::vertex>(v);
 
@@ -97,6 +149,11 @@ namespace fst {
     lazy_pair_fst<fst1_type, fst2_type>::out_edges(
         typename lazy_pair_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::out_edges,
+            this->out_edges_cache != nullptr && *this->out_edges_vertex == v);
+#endif
+
         if (out_edges_cache == nullptr || *out_edges_vertex != v) {
             std::vector<typename lazy_pair_fst<fst1_type, fst2_type>::edge> out_edges;
 
@@ -111,6 +168,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, out_edges);
+#endif
+
             out_edges_vertex = std::make_shared<
                 typename lazy_pair_fst<fst1_type, fst2_type>::vertex>(v);
 
@@ -214,6 +275,11 @@ namespace fst {
     lazy_pair_fst<fst1_type, fst2_type>::in_edges_input_map(
         typename lazy_pair_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::in_edges_input_map,
+            this->in_edges_input_map_cache != nullptr && *this->in_edges_input_map_vertex == v);
+#endif
+
         if (in_edges_input_map_cache == nullptr || *in_edges_input_map_vertex != v) {
             std::unordered_map<input_symbol, std::vector<edge>> in_edges_input_map;
 
@@ -229,6 +295,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, in_edges_input_map);
+#endif
+
             in_edges_input_map_vertex = std::make_shared<vertex>(v);
             in_edges_input_map_cache = std::make_shared<
                 std::unordered_map<input_symbol, std::vector<edge>>>(in_edges_input_map);
@@ -243,6 +313,11 @@ namespace fst {
     lazy_pair_fst<fst1_type, fst2_type>::in_edges_output_map(
         typename lazy_pair_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::in_edges_output_map,
+            this->in_edges_output_map_cache != nullptr && *this->in_edges_output_map_vertex == v);
+#endif
+
         if (in_edges_output_map_cache == nullptr || *in_edges_output_map_vertex != v) {
             std::unordered_map<output_symbol, std::vector<edge>> in_edges_output_map;
 
@@ -258,6 +333,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, in_edges_output_map);
+#endif
+
             in_edges_output_map_vertex = std::make_shared<vertex>(v);
             in_edges_output_map_cache = std::make_shared<
                 std::unordered_map<output_symbol, std::vector<edge>>>(in_edges_output_map);
@@ -272,6 +351,11 @@ namespace fst {
     lazy_pair_fst<fst1_type, fst2_type>::out_edges_input_map(
         typename lazy_pair_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::out_edges_input_map,
+            this->out_edges_input_map_cache != nullptr && *this->out_edges_input_map_vertex == v);
+#endif
+
         if (out_edges_input_map_cache == nullptr || *out_edges_input_map_vertex != v) {
             std::unordered_map<output_symbol, std::vector<edge>> out_edges_input_map;
 
@@ -287,6 +371,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, out_edges_input_map);
+#endif
+
             out_edges_input_map_vertex = std::make_shared<vertex>(v);
             out_edges_input_map_cache = std::make_shared<
                 std::unordered_map<input_symbol, std::vector<edge>>>(out_edges_input_map);
@@ -301,6 +389,11 @@ namespace fst {
     lazy_pair_fst<fst1_type, fst2_type>::out_edges_output_map(
         typename lazy_pair_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::out_edges_output_map,
+            this->out_edges_output_map_cache != nullptr && *this->out_edges_output_map_vertex == v);
+#endif
+
         if (out_edges_output_map_cache == nullptr || *out_edges_output_map_vertex != v) {
             std::unordered_map<output_symbol, std::vector<edge>> out_edges_output_map;
 
@@ -316,6 +409,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, out_edges_output_map);
+#endif
+
             out_edges_output_map_vertex = std::make_shared<vertex>(v);
             out_edges_output_map_cache = std::make_shared<
                 std::unordered_map<output_symbol, std::vector<edge>>>(out_edges_output_map);
@@ -336,6 +433,11 @@ namespace fst {
     lazy_pair_mode1_fst<fst1_type, fst2_type>::in_edges(
         lazy_pair_mode1_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::in_edges,
+            this->in_edges_cache != nullptr && *this->in_edges_vertex == v);
+#endif
+
         if (this->in_edges_cache == nullptr || *this->in_edges_vertex != v) {
             std::vector<typename lazy_pair_fst<fst1_type, fst2_type>::edge> in_edges;
 
@@ -344,6 +446,9 @@ namespace fst {
 
             for (auto& e2: edges2) {
                 if (!ebt::in(this->fst2_.input(e2), edges1_map)) {
+#if FST_STATS
+                    ++this->stats_.label_misses;
+#endif
                     continue;
                 }
 
@@ -352,6 +457,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, in_edges);
+#endif
+
             this->in_edges_vertex = std::make_shared<
                 typename lazy_pair_fst<fst1_type, fst2_type>::vertex>(v);
 
@@ -367,6 +476,11 @@ namespace fst {
     lazy_pair_mode1_fst<fst1_type, fst2_type>::out_edges(
         typename lazy_pair_mode1_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::out_edges,
+            this->out_edges_cache != nullptr && *this->out_edges_vertex == v);
+#endif
+
         if (this->out_edges_cache == nullptr || *this->out_edges_vertex != v) {
             std::vector<typename lazy_pair_fst<fst1_type, fst2_type>::edge> out_edges;
 
@@ -375,6 +489,9 @@ namespace fst {
 
             for (auto& e2: edges2) {
                 if (!ebt::in(this->fst2_.input(e2), edges1_map)) {
+#if FST_STATS
+                    ++this->stats_.label_misses;
+#endif
                     continue;
                 }
 
@@ -383,6 +500,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, out_edges);
+#endif
+
             this->out_edges_vertex = std::make_shared<
                 typename lazy_pair_fst<fst1_type, fst2_type>::vertex>(v);
 
@@ -415,6 +536,11 @@ namespace fst {
     lazy_pair_mode1_fst<fst1_type, fst2_type>::in_edges_input_map(
         lazy_pair_mode1_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::in_edges_input_map,
+            this->in_edges_input_map_cache != nullptr && *this->in_edges_input_map_vertex == v);
+#endif
+
         if (this->in_edges_input_map_cache == nullptr || *this->in_edges_input_map_vertex != v) {
             std::unordered_map<input_symbol, std::vector<edge>> in_edges_input_map;
 
@@ -423,6 +549,9 @@ namespace fst {
 
             for (auto& e2: edges2) {
                 if (!ebt::in(this->fst2_.input(e2), edges1_map)) {
+#if FST_STATS
+                    ++this->stats_.label_misses;
+#endif
                     continue;
                 }
 
@@ -432,6 +561,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, in_edges_input_map);
+#endif
+
             this->in_edges_input_map_vertex = std::make_shared<vertex>(v);
             this->in_edges_input_map_cache = std::make_shared<
                 std::unordered_map<input_symbol, std::vector<edge>>>(in_edges_input_map);
@@ -446,6 +579,11 @@ namespace fst {
     lazy_pair_mode1_fst<fst1_type, fst2_type>::in_edges_output_map(
         lazy_pair_mode1_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::in_edges_output_map,
+            this->in_edges_output_map_cache != nullptr && *this->in_edges_output_map_vertex == v);
+#endif
+
         if (this->in_edges_output_map_cache == nullptr || *this->in_edges_output_map_vertex != v) {
             std::unordered_map<output_symbol, std::vector<edge>> in_edges_output_map;
 
@@ -454,6 +592,9 @@ namespace fst {
 
             for (auto& e2: edges2) {
                 if (!ebt::in(this->fst2_.input(e2), edges1_map)) {
+#if FST_STATS
+                    ++this->stats_.label_misses;
+#endif
                     continue;
                 }
 
@@ -463,6 +604,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, in_edges_output_map);
+#endif
+
             this->in_edges_output_map_vertex = std::make_shared<vertex>(v);
             this->in_edges_output_map_cache = std::make_shared<
                 std::unordered_map<output_symbol, std::vector<edge>>>(in_edges_output_map);
@@ -477,6 +622,11 @@ namespace fst {
     lazy_pair_mode1_fst<fst1_type, fst2_type>::out_edges_input_map(
         typename lazy_pair_mode1_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::out_edges_input_map,
+            this->out_edges_input_map_cache != nullptr && *this->out_edges_input_map_vertex == v);
+#endif
+
         if (this->out_edges_input_map_cache == nullptr || *this->out_edges_input_map_vertex != v) {
             std::unordered_map<input_symbol, std::vector<edge>> out_edges_input_map;
 
@@ -485,6 +635,9 @@ namespace fst {
 
             for (auto& e2: edges2) {
                 if (!ebt::in(this->fst2_.input(e2), edges1_map)) {
+#if FST_STATS
+                    ++this->stats_.label_misses;
+#endif
                     continue;
                 }
 
@@ -494,6 +647,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, out_edges_input_map);
+#endif
+
             this->out_edges_input_map_vertex = std::make_shared<vertex>(v);
             this->out_edges_input_map_cache = std::make_shared<
                 std::unordered_map<input_symbol, std::vector<edge>>>(out_edges_input_map);
@@ -508,6 +665,11 @@ namespace fst {
     lazy_pair_mode1_fst<fst1_type, fst2_type>::out_edges_output_map(
         typename lazy_pair_mode1_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::out_edges_output_map,
+            this->out_edges_output_map_cache != nullptr && *this->out_edges_output_map_vertex == v);
+#endif
+
         if (this->out_edges_output_map_cache == nullptr || *this->out_edges_output_map_vertex != v) {
             std::unordered_map<output_symbol, std::vector<edge>> out_edges_output_map;
 
@@ -516,6 +678,9 @@ namespace fst {
 
             for (auto& e2: edges2) {
                 if (!ebt::in(this->fst2_.input(e2), edges1_map)) {
+#if FST_STATS
+                    ++this->stats_.label_misses;
+#endif
                     continue;
                 }
 
@@ -525,6 +690,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, out_edges_output_map);
+#endif
+
             this->out_edges_output_map_vertex = std::make_shared<vertex>(v);
             this->out_edges_output_map_cache = std::make_shared<
                 std::unordered_map<output_symbol, std::vector<edge>>>(out_edges_output_map);
@@ -543,6 +712,11 @@ namespace fst {
     lazy_pair_mode2_fst<fst1_type, fst2_type>::in_edges(
         lazy_pair_mode2_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::in_edges,
+            this->in_edges_cache != nullptr && *this->in_edges_vertex == v);
+#endif
+
         if (this->in_edges_cache == nullptr || *this->in_edges_vertex != v) {
             std::vector<typename lazy_pair_fst<fst1_type, fst2_type>::edge> in_edges;
 
@@ -551,6 +725,9 @@ namespace fst {
 
             for (auto& e1: edges1) {
                 if (!ebt::in(this->fst1_.output(e1), edges2_map)) {
+#if FST_STATS
+                    ++this->stats_.label_misses;
+#endif
                     continue;
                 }
 
@@ -559,6 +736,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, in_edges);
+#endif
+
             this->in_edges_vertex = std::make_shared<
                 typename lazy_pair_fst<fst1_type, fst2_type>::vertex>(v);
 
@@ -574,6 +755,11 @@ namespace fst {
     lazy_pair_mode2_fst<fst1_type, fst2_type>::out_edges(
         typename lazy_pair_mode2_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::out_edges,
+            this->out_edges_cache != nullptr && *this->out_edges_vertex == v);
+#endif
+
         if (this->out_edges_cache == nullptr || *this->out_edges_vertex != v) {
             std::vector<typename lazy_pair_fst<fst1_type, fst2_type>::edge> out_edges;
 
@@ -582,6 +768,9 @@ namespace fst {
 
             for (auto& e1: edges1) {
                 if (!ebt::in(this->fst1_.output(e1), edges2_map)) {
+#if FST_STATS
+                    ++this->stats_.label_misses;
+#endif
                     continue;
                 }
 
@@ -590,6 +779,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, out_edges);
+#endif
+
             this->out_edges_vertex = std::make_shared<
                 typename lazy_pair_fst<fst1_type, fst2_type>::vertex>(v);
 
@@ -622,6 +815,11 @@ namespace fst {
     lazy_pair_mode2_fst<fst1_type, fst2_type>::in_edges_input_map(
         lazy_pair_mode2_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::in_edges_input_map,
+            this->in_edges_input_map_cache != nullptr && *this->in_edges_input_map_vertex == v);
+#endif
+
         if (this->in_edges_input_map_cache == nullptr || *this->in_edges_input_map_vertex != v) {
             std::unordered_map<input_symbol, std::vector<edge>> in_edges_input_map;
 
@@ -630,6 +828,9 @@ namespace fst {
 
             for (auto& e1: edges1) {
                 if (!ebt::in(this->fst1_.output(e1), edges2_map)) {
+#if FST_STATS
+                    ++this->stats_.label_misses;
+#endif
                     continue;
                 }
 
@@ -639,6 +840,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, in_edges_input_map);
+#endif
+
             this->in_edges_input_map_vertex = std::make_shared<vertex>(v);
             this->in_edges_input_map_cache = std::make_shared<
                 std::unordered_map<input_symbol, std::vector<edge>>>(std::move(in_edges_input_map));
@@ -653,6 +858,11 @@ namespace fst {
     lazy_pair_mode2_fst<fst1_type, fst2_type>::in_edges_output_map(
         lazy_pair_mode2_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::in_edges_output_map,
+            this->in_edges_output_map_cache != nullptr && *this->in_edges_output_map_vertex == v);
+#endif
+
         if (this->in_edges_output_map_cache == nullptr || *this->in_edges_output_map_vertex != v) {
             std::unordered_map<output_symbol, std::vector<edge>> in_edges_output_map;
 
@@ -661,6 +871,9 @@ namespace fst {
 
             for (auto& e1: edges1) {
                 if (!ebt::in(this->fst1_.output(e1), edges2_map)) {
+#if FST_STATS
+                    ++this->stats_.label_misses;
+#endif
                     continue;
                 }
 
@@ -670,6 +883,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, in_edges_output_map);
+#endif
+
             this->in_edges_output_map_vertex = std::make_shared<vertex>(v);
             this->in_edges_output_map_cache = std::make_shared<
                 std::unordered_map<output_symbol, std::vector<edge>>>(std::move(in_edges_output_map));
@@ -684,6 +901,11 @@ namespace fst {
     lazy_pair_mode2_fst<fst1_type, fst2_type>::out_edges_input_map(
         typename lazy_pair_mode2_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::out_edges_input_map,
+            this->out_edges_input_map_cache != nullptr && *this->out_edges_input_map_vertex == v);
+#endif
+
         if (this->out_edges_input_map_cache == nullptr || *this->out_edges_input_map_vertex != v) {
             std::unordered_map<input_symbol, std::vector<edge>> out_edges_input_map;
 
@@ -692,6 +914,9 @@ namespace fst {
 
             for (auto& e1: edges1) {
                 if (!ebt::in(this->fst1_.output(e1), edges2_map)) {
+#if FST_STATS
+                    ++this->stats_.label_misses;
+#endif
                     continue;
                 }
 
@@ -701,6 +926,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, out_edges_input_map);
+#endif
+
             this->out_edges_input_map_vertex = std::make_shared<vertex>(v);
             this->out_edges_input_map_cache = std::make_shared<
                 std::unordered_map<input_symbol, std::vector<edge>>>(std::move(out_edges_input_map));
@@ -715,6 +944,11 @@ namespace fst {
     lazy_pair_mode2_fst<fst1_type, fst2_type>::out_edges_output_map(
         typename lazy_pair_mode2_fst<fst1_type, fst2_type>::vertex v) const
     {
+#if FST_STATS
+        this->stats_.count(pair_fst_stats::out_edges_output_map,
+            this->out_edges_output_map_cache != nullptr && *this->out_edges_output_map_vertex == v);
+#endif
+
         if (this->out_edges_output_map_cache == nullptr || *this->out_edges_output_map_vertex != v) {
             std::unordered_map<output_symbol, std::vector<edge>> out_edges_output_map;
 
@@ -723,6 +957,9 @@ namespace fst {
 
             for (auto& e1: edges1) {
                 if (!ebt::in(this->fst1_.output(e1), edges2_map)) {
+#if FST_STATS
+                    ++this->stats_.label_misses;
+#endif
                     continue;
                 }
 
@@ -732,6 +969,10 @@ namespace fst {
                 }
             }
 
+#if FST_STATS
+            this->note_expanded(v, out_edges_output_map);
+#endif
+
             this->out_edges_output_map_vertex = std::make_shared<vertex>(v);
             this->out_edges_output_map_cache = std::make_shared<
                 std::unordered_map<output_symbol, std::vector<edge>>>(std::move(out_edges_output_map));
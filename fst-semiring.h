@@ -0,0 +1,516 @@
+#ifndef FST_SEMIRING_H
+#define FST_SEMIRING_H
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "ebt/ebt.h"
+#include "fst/fst.h"
+
+namespace fst {
+
+    /*
+     * A semiring defines `value_type`, `zero()`, `one()`, `plus`, `times`,
+     * `edge_value(f, e)` that turns an edge into a value, and `sum(v, n)`
+     * that adds up `n` values.
+     *
+     * `semiring_base` provides `sum` as a fold over `plus`, so a new
+     * semiring only has to define the rest.  Semirings with a faster way
+     * of summing a whole array override it.
+     *
+     * As everywhere else in this library, weights are scores and larger
+     * is better, so the tropical semiring is max-plus.
+     *
+     */
+    template <class semiring>
+    struct semiring_base {
+
+        template <class value>
+        static value sum(value const *v, int n)
+        {
+            value result = v[0];
+
+            for (int i = 1; i < n; ++i) {
+                result = semiring::plus(result, v[i]);
+            }
+
+            return result;
+        }
+
+    };
+
+    struct tropical_semiring
+        : public semiring_base<tropical_semiring> {
+
+        using value_type = double;
+
+        static double zero()
+        {
+            return -std::numeric_limits<double>::infinity();
+        }
+
+        static double one()
+        {
+            return 0;
+        }
+
+        static double plus(double a, double b)
+        {
+            return std::max(a, b);
+        }
+
+        static double times(double a, double b)
+        {
+            return a + b;
+        }
+
+        template <class fst>
+        static double edge_value(fst const& f, typename fst::edge const& e)
+        {
+            return f.weight(e);
+        }
+
+        static double sum(double const *v, int n)
+        {
+            double result = v[0];
+
+            for (int i = 1; i < n; ++i) {
+                result = (v[i] > result ? v[i] : result);
+            }
+
+            return result;
+        }
+
+    };
+
+    /*
+     * Ways of computing log(exp(a) + exp(b)).  Each defines `log_add`
+     * and `sum`, which adds up `n` values in the log domain.
+     *
+     * `exact_log_add` calls `log1p(exp(.))`.  The approximations only
+     * evaluate log(1 + exp(d)) for d in (-11, 0], and return the larger
+     * argument below that, where the true correction is under 2e-5.
+     * Both stay within 1e-4 of the exact value.
+     *
+     *   - `table_log_add` interpolates linearly in a table with 64
+     *     entries per unit.
+     *   - `poly_log_add` evaluates a cubic, one per unit interval.
+     *
+     * All three can be instantiated with `float`.
+     *
+     */
+    template <class real = double>
+    struct exact_log_add {
+
+        using value_type = real;
+
+        static real log_add(real a, real b)
+        {
+            real large = std::max(a, b);
+            real small = std::min(a, b);
+
+            if (large == -std::numeric_limits<real>::infinity()) {
+                return large;
+            }
+
+            return large + std::log1p(std::exp(small - large));
+        }
+
+        /*
+         * Shift by the max and add up the exponentials in one pass,
+         * so there is one `log` in total instead of one `log1p` per
+         * value as with `log_add`.
+         *
+         */
+        static real sum(real const *v, int n)
+        {
+            real max = v[0];
+
+            for (int i = 1; i < n; ++i) {
+                max = (v[i] > max ? v[i] : max);
+            }
+
+            if (max == -std::numeric_limits<real>::infinity()) {
+                return max;
+            }
+
+            real s = 0;
+
+            for (int i = 0; i < n; ++i) {
+                s += std::exp(v[i] - max);
+            }
+
+            return max + std::log(s);
+        }
+
+    };
+
+    template <class real = double>
+    struct table_log_add {
+
+        using value_type = real;
+
+        static constexpr int range = 11;
+        static constexpr int resolution = 64;
+
+        static std::vector<real> make_table()
+        {
+            std::vector<real> table;
+            table.resize(range * resolution + 2);
+
+            for (int i = 0; i < table.size(); ++i) {
+                table[i] = std::log1p(std::exp(-double(i) / resolution));
+            }
+
+            return table;
+        }
+
+        static real log_add(real a, real b)
+        {
+            static std::vector<real> const table = make_table();
+
+            real large = std::max(a, b);
+            real d = large - std::min(a, b);
+
+            // Also true when both are -inf and d is nan.
+            if (!(d < range)) {
+                return large;
+            }
+
+            real x = d * resolution;
+            int i = int(x);
+            real frac = x - i;
+
+            return large + table[i] + (table[i + 1] - table[i]) * frac;
+        }
+
+        static real sum(real const *v, int n)
+        {
+            real result = v[0];
+
+            for (int i = 1; i < n; ++i) {
+                result = log_add(result, v[i]);
+            }
+
+            return result;
+        }
+
+    };
+
+    template <class real = double>
+    struct poly_log_add {
+
+        using value_type = real;
+
+        static constexpr int range = 11;
+
+        static real log_add(real a, real b)
+        {
+            // Coefficients, lowest order first, of the cubic for
+            // d in [-(k + 1), -k] in terms of t = d + k.
+            static real const coeff[range][4] = {
+                { 0.69318108433469161, 0.50108973418253977, 0.1305764315365863, 0.00937871694496549 },
+                { 0.31325965214425228, 0.26888238346274557, 0.09817643715422128, 0.015632593427919245 },
+                { 0.12691471355560735, 0.11877732276409217, 0.050367261446486629, 0.0099300494627119103 },
+                { 0.048579064702527541, 0.047159493366012543, 0.021223998841803916, 0.0045007896137397802 },
+                { 0.01814627842852716, 0.017868737511439102, 0.0082253038178912892, 0.0017905408943546272 },
+                { 0.0067139159256831308, 0.0066467160912541314, 0.003085401927292473, 0.00067809778632519789 },
+                { 0.0024751454810935502, 0.0024552407641956946, 0.0011432622710599088, 0.00025214358865874076 },
+                { 0.00091126618979436348, 0.00090460025319864866, 0.00042170122160204202, 9.3124943509360848e-05 },
+                { 0.00033533246382880732, 0.0003329693007889658, 0.00015528698466070926, 3.4308507088185892e-05 },
+                { 0.00012337496808869917, 0.00012251767891530214, 5.7147449479833277e-05, 1.2628135717955485e-05 },
+                { 4.5388880602297211e-05, 4.50751356161738e-05, 2.1026155307384962e-05, 4.6465442312478142e-06 }
+            };
+
+            real large = std::max(a, b);
+            real d = large - std::min(a, b);
+
+            if (!(d < range)) {
+                return large;
+            }
+
+            int k = int(d);
+            real t = k - d;
+            real const *c = coeff[k];
+
+            return large + (c[0] + t * (c[1] + t * (c[2] + t * c[3])));
+        }
+
+        static real sum(real const *v, int n)
+        {
+            real result = v[0];
+
+            for (int i = 1; i < n; ++i) {
+                result = log_add(result, v[i]);
+            }
+
+            return result;
+        }
+
+    };
+
+    template <class log_add_type>
+    struct basic_log_semiring
+        : public semiring_base<basic_log_semiring<log_add_type>> {
+
+        using value_type = typename log_add_type::value_type;
+
+        static value_type zero()
+        {
+            return -std::numeric_limits<value_type>::infinity();
+        }
+
+        static value_type one()
+        {
+            return 0;
+        }
+
+        static value_type plus(value_type a, value_type b)
+        {
+            return log_add_type::log_add(a, b);
+        }
+
+        static value_type times(value_type a, value_type b)
+        {
+            return a + b;
+        }
+
+        template <class fst>
+        static value_type edge_value(fst const& f, typename fst::edge const& e)
+        {
+            return f.weight(e);
+        }
+
+        static value_type sum(value_type const *v, int n)
+        {
+            return log_add_type::sum(v, n);
+        }
+
+    };
+
+    using log_semiring = basic_log_semiring<exact_log_add<double>>;
+
+    /*
+     * Max-plus that also remembers the last edge of the best path.
+     * Ties are broken in favor of the first value.
+     *
+     */
+    template <class edge>
+    struct viterbi_semiring
+        : public semiring_base<viterbi_semiring<edge>> {
+
+        struct value_type {
+            edge pi;
+            double value;
+        };
+
+        static value_type zero()
+        {
+            return value_type { edge_trait<edge>::null,
+                -std::numeric_limits<double>::infinity() };
+        }
+
+        static value_type one()
+        {
+            return value_type { edge_trait<edge>::null, 0 };
+        }
+
+        static value_type const& plus(value_type const& a, value_type const& b)
+        {
+            return b.value > a.value ? b : a;
+        }
+
+        static value_type times(value_type const& a, value_type const& b)
+        {
+            return value_type { b.pi, a.value + b.value };
+        }
+
+        template <class fst>
+        static value_type edge_value(fst const& f, edge const& e)
+        {
+            return value_type { e, f.weight(e) };
+        }
+
+        static value_type sum(value_type const *v, int n)
+        {
+            int argmax = 0;
+
+            for (int i = 1; i < n; ++i) {
+                if (v[i].value > v[argmax].value) {
+                    argmax = i;
+                }
+            }
+
+            return v[argmax];
+        }
+
+    };
+
+    /*
+     * The expectation semiring in the log domain.  `log_p` is the log
+     * sum of path weights, as in `log_semiring`, and `r` is the
+     * expectation of the path weight under those paths.  For example,
+     * the forward value of a final vertex has the expected score of
+     * the lattice in `r`.
+     *
+     */
+    struct expectation_semiring
+        : public semiring_base<expectation_semiring> {
+
+        struct value_type {
+            double log_p;
+            double r;
+        };
+
+        static value_type zero()
+        {
+            return value_type { -std::numeric_limits<double>::infinity(), 0 };
+        }
+
+        static value_type one()
+        {
+            return value_type { 0, 0 };
+        }
+
+        static value_type plus(value_type const& a, value_type const& b)
+        {
+            if (a.log_p == -std::numeric_limits<double>::infinity()) {
+                return b;
+            } else if (b.log_p == -std::numeric_limits<double>::infinity()) {
+                return a;
+            }
+
+            double log_p = ebt::log_add(a.log_p, b.log_p);
+
+            return value_type { log_p,
+                std::exp(a.log_p - log_p) * a.r + std::exp(b.log_p - log_p) * b.r };
+        }
+
+        static value_type times(value_type const& a, value_type const& b)
+        {
+            return value_type { a.log_p + b.log_p, a.r + b.r };
+        }
+
+        template <class fst>
+        static value_type edge_value(fst const& f, typename fst::edge const& e)
+        {
+            double w = f.weight(e);
+            return value_type { w, w };
+        }
+
+    };
+
+    /*
+     * The `k` best path scores, in decreasing order and padded with -inf.
+     *
+     */
+    template <int k>
+    struct k_tropical_semiring
+        : public semiring_base<k_tropical_semiring<k>> {
+
+        using value_type = std::array<double, k>;
+
+        static value_type zero()
+        {
+            value_type result;
+            result.fill(-std::numeric_limits<double>::infinity());
+            return result;
+        }
+
+        static value_type one()
+        {
+            value_type result = zero();
+            result[0] = 0;
+            return result;
+        }
+
+        static value_type plus(value_type const& a, value_type const& b)
+        {
+            value_type result;
+
+            int i = 0;
+            int j = 0;
+
+            for (int m = 0; m < k; ++m) {
+                if (a[i] >= b[j]) {
+                    result[m] = a[i];
+                    ++i;
+                } else {
+                    result[m] = b[j];
+                    ++j;
+                }
+            }
+
+            return result;
+        }
+
+        static value_type times(value_type const& a, value_type const& b)
+        {
+            value_type result = zero();
+
+            for (int i = 0; i < k && a[i] != -std::numeric_limits<double>::infinity(); ++i) {
+                value_type row = zero();
+
+                for (int j = 0; j < k; ++j) {
+                    row[j] = a[i] + b[j];
+                }
+
+                result = plus(result, row);
+            }
+
+            return result;
+        }
+
+        template <class fst>
+        static value_type edge_value(fst const& f, typename fst::edge const& e)
+        {
+            value_type result = zero();
+            result[0] = f.weight(e);
+            return result;
+        }
+
+    };
+
+    /*
+     * Directions for `path_sum`.  Going forward, a vertex collects
+     * values from the tails of its in-edges; going backward, from the
+     * heads of its out-edges.
+     *
+     */
+    struct forward_direction {
+
+        template <class fst>
+        static std::vector<typename fst::edge> const& edges(fst const& f, typename fst::vertex const& v)
+        {
+            return f.in_edges(v);
+        }
+
+        template <class fst>
+        static typename fst::vertex other(fst const& f, typename fst::edge const& e)
+        {
+            return f.tail(e);
+        }
+
+    };
+
+    struct backward_direction {
+
+        template <class fst>
+        static std::vector<typename fst::edge> const& edges(fst const& f, typename fst::vertex const& v)
+        {
+            return f.out_edges(v);
+        }
+
+        template <class fst>
+        static typename fst::vertex other(fst const& f, typename fst::edge const& e)
+        {
+            return f.head(e);
+        }
+
+    };
+
+}
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef FST_TRACE_H
+#define FST_TRACE_H
+
+/*
+ * Tracing for the algorithms in `fst-algo.h`, compiled in only with
+ * `-DFST_TRACE=1`.  Without it, this header defines nothing and the
+ * algorithms carry no tracing code.
+ *
+ * Each traced call (`topo_order`, the `merge`s, `best_path`,
+ * `next_best`, ...) becomes one `trace_event` with its start time,
+ * its duration and up to four counters, e.g., vertices visited and
+ * edges relaxed.  Events go to the sink set with `set_trace_sink`,
+ * and are dropped if there is none.  The sink is called from the
+ * thread that ran the algorithm, so it has to be thread-safe when the
+ * algorithms run in parallel, e.g., under `batch_run`.
+ *
+ * `chrome_trace_writer` is a sink that writes the Chrome trace event
+ * format, viewable in chrome://tracing or Perfetto:
+ *
+ *     std::ofstream ofs { "trace.json" };
+ *     fst::chrome_trace_writer writer { ofs };
+ *     fst::set_trace_sink(std::ref(writer));
+ *     ...
+ *     fst::set_trace_sink(nullptr);
+ *     writer.close();
+ *
+ */
+
+#if FST_TRACE
+
+#include <chrono>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+namespace fst {
+
+    struct trace_event {
+        char const* name;
+        std::thread::id thread;
+        double start_us;
+        double duration_us;
+
+        int ncounts;
+        char const* count_names[4];
+        long counts[4];
+    };
+
+    using trace_sink = std::function<void(trace_event const&)>;
+
+    inline trace_sink& current_trace_sink()
+    {
+        static trace_sink sink;
+        return sink;
+    }
+
+    /*
+     * Not thread-safe; set the sink before starting the algorithms.
+     */
+    inline void set_trace_sink(trace_sink sink)
+    {
+        current_trace_sink() = sink;
+    }
+
+    inline double trace_now_us()
+    {
+        static auto epoch = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    /*
+     * Times the enclosing scope and sends the event to the sink when
+     * the scope ends.  Counters are named in the constructor and
+     * updated through `counts`.
+     *
+     */
+    struct scoped_trace {
+
+        trace_event event;
+
+        scoped_trace(char const* name, std::initializer_list<char const*> count_names = {})
+        {
+            event.name = name;
+            event.thread = std::this_thread::get_id();
+            event.ncounts = 0;
+
+            for (auto& c: count_names) {
+                if (event.ncounts < 4) {
+                    event.count_names[event.ncounts] = c;
+                    event.counts[event.ncounts] = 0;
+                    ++event.ncounts;
+                }
+            }
+
+            event.start_us = trace_now_us();
+        }
+
+        ~scoped_trace()
+        {
+            event.duration_us = trace_now_us() - event.start_us;
+
+            trace_sink& sink = current_trace_sink();
+
+            if (sink) {
+                sink(event);
+            }
+        }
+
+        long& counts(int i)
+        {
+            return event.counts[i];
+        }
+
+    };
+
+    /*
+     * Writes events as a JSON array of complete ("X") events.  Writes
+     * are serialized with a mutex, so the writer can be shared by
+     * threads.  `close` ends the array; Chrome also loads a file whose
+     * array was never closed.
+     *
+     */
+    struct chrome_trace_writer {
+
+        std::ostream& os;
+        std::mutex mutex;
+        bool first;
+        bool closed;
+
+        chrome_trace_writer(std::ostream& os)
+            : os(os), first(true), closed(false)
+        {
+            os << "[";
+        }
+
+        ~chrome_trace_writer()
+        {
+            close();
+        }
+
+        void operator()(trace_event const& event)
+        {
+            std::lock_guard<std::mutex> lock { mutex };
+
+            if (closed) {
+                return;
+            }
+
+            os << (first ? "\n" : ",\n");
+            first = false;
+
+            os << "{\"name\": \"" << event.name << "\", \"ph\": \"X\""
+                << ", \"ts\": " << event.start_us
+                << ", \"dur\": " << event.duration_us
+                << ", \"pid\": 0"
+                << ", \"tid\": " << std::hash<std::thread::id>()(event.thread) % 100000
+                << ", \"args\": {";
+
+            for (int i = 0; i < event.ncounts; ++i) {
+                os << (i == 0 ? "" : ", ") << "\"" << event.count_names[i] << "\": "
+                    << event.counts[i];
+            }
+
+            os << "}}";
+        }
+
+        void close()
+        {
+            std::lock_guard<std::mutex> lock { mutex };
+
+            if (!closed) {
+                os << "\n]\n";
+                os.flush();
+                closed = true;
+            }
+        }
+
+    };
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,884 @@
+namespace fst {
+
+    template <class fst_type>
+    reverse_fst<fst_type>::reverse_fst(fst_type f)
+        : fst_(f)
+    {}
+
+    template <class fst_type>
+    std::vector<typename reverse_fst<fst_type>::vertex> const&
+    reverse_fst<fst_type>::vertices() const
+    {
+        return fst_.vertices();
+    }
+
+    template <class fst_type>
+    std::vector<typename reverse_fst<fst_type>::edge> const&
+    reverse_fst<fst_type>::edges() const
+    {
+        return fst_.edges();
+    }
+
+    template <class fst_type>
+    typename reverse_fst<fst_type>::vertex
+    reverse_fst<fst_type>::tail(typename reverse_fst<fst_type>::edge e) const
+    {
+        return fst_.head(e);
+    }
+
+    template <class fst_type>
+    typename reverse_fst<fst_type>::vertex
+    reverse_fst<fst_type>::head(typename reverse_fst<fst_type>::edge e) const
+    {
+        return fst_.tail(e);
+    }
+
+    template <class fst_type>
+    std::vector<typename reverse_fst<fst_type>::edge> const&
+    reverse_fst<fst_type>::in_edges(typename reverse_fst<fst_type>::vertex v) const
+    {
+        return fst_.out_edges(v);
+    }
+
+    template <class fst_type>
+    std::vector<typename reverse_fst<fst_type>::edge> const&
+    reverse_fst<fst_type>::out_edges(typename reverse_fst<fst_type>::vertex v) const
+    {
+        return fst_.in_edges(v);
+    }
+
+    template <class fst_type>
+    std::vector<typename reverse_fst<fst_type>::vertex> const&
+    reverse_fst<fst_type>::initials() const
+    {
+        return fst_.finals();
+    }
+
+    template <class fst_type>
+    std::vector<typename reverse_fst<fst_type>::vertex> const&
+    reverse_fst<fst_type>::finals() const
+    {
+        return fst_.initials();
+    }
+
+    template <class fst_type>
+    double
+    reverse_fst<fst_type>::weight(typename reverse_fst<fst_type>::edge e) const
+    {
+        return fst_.weight(e);
+    }
+
+    template <class fst_type>
+    typename reverse_fst<fst_type>::input_symbol const&
+    reverse_fst<fst_type>::input(typename reverse_fst<fst_type>::edge e) const
+    {
+        return fst_.input(e);
+    }
+
+    template <class fst_type>
+    typename reverse_fst<fst_type>::output_symbol const&
+    reverse_fst<fst_type>::output(typename reverse_fst<fst_type>::edge e) const
+    {
+        return fst_.output(e);
+    }
+
+    template <class fst_type>
+    long
+    reverse_fst<fst_type>::time(typename reverse_fst<fst_type>::vertex v) const
+    {
+        return -fst_.time(v);
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename reverse_fst<fst_type>::input_symbol,
+        std::vector<typename reverse_fst<fst_type>::edge>> const&
+    reverse_fst<fst_type>::in_edges_input_map(
+        typename reverse_fst<fst_type>::vertex v) const
+    {
+        return fst_.out_edges_input_map(v);
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename reverse_fst<fst_type>::output_symbol,
+        std::vector<typename reverse_fst<fst_type>::edge>> const&
+    reverse_fst<fst_type>::in_edges_output_map(
+        typename reverse_fst<fst_type>::vertex v) const
+    {
+        return fst_.out_edges_output_map(v);
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename reverse_fst<fst_type>::input_symbol,
+        std::vector<typename reverse_fst<fst_type>::edge>> const&
+    reverse_fst<fst_type>::out_edges_input_map(
+        typename reverse_fst<fst_type>::vertex v) const
+    {
+        return fst_.in_edges_input_map(v);
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename reverse_fst<fst_type>::output_symbol,
+        std::vector<typename reverse_fst<fst_type>::edge>> const&
+    reverse_fst<fst_type>::out_edges_output_map(
+        typename reverse_fst<fst_type>::vertex v) const
+    {
+        return fst_.in_edges_output_map(v);
+    }
+
+    template <class fst_type>
+    project_fst<fst_type>::project_fst(fst_type f, project_side side)
+        : fst_(f), side(side)
+    {}
+
+    template <class fst_type>
+    std::vector<typename project_fst<fst_type>::vertex> const&
+    project_fst<fst_type>::vertices() const
+    {
+        return fst_.vertices();
+    }
+
+    template <class fst_type>
+    std::vector<typename project_fst<fst_type>::edge> const&
+    project_fst<fst_type>::edges() const
+    {
+        return fst_.edges();
+    }
+
+    template <class fst_type>
+    typename project_fst<fst_type>::vertex
+    project_fst<fst_type>::tail(typename project_fst<fst_type>::edge e) const
+    {
+        return fst_.tail(e);
+    }
+
+    template <class fst_type>
+    typename project_fst<fst_type>::vertex
+    project_fst<fst_type>::head(typename project_fst<fst_type>::edge e) const
+    {
+        return fst_.head(e);
+    }
+
+    template <class fst_type>
+    std::vector<typename project_fst<fst_type>::edge> const&
+    project_fst<fst_type>::in_edges(typename project_fst<fst_type>::vertex v) const
+    {
+        return fst_.in_edges(v);
+    }
+
+    template <class fst_type>
+    std::vector<typename project_fst<fst_type>::edge> const&
+    project_fst<fst_type>::out_edges(typename project_fst<fst_type>::vertex v) const
+    {
+        return fst_.out_edges(v);
+    }
+
+    template <class fst_type>
+    std::vector<typename project_fst<fst_type>::vertex> const&
+    project_fst<fst_type>::initials() const
+    {
+        return fst_.initials();
+    }
+
+    template <class fst_type>
+    std::vector<typename project_fst<fst_type>::vertex> const&
+    project_fst<fst_type>::finals() const
+    {
+        return fst_.finals();
+    }
+
+    template <class fst_type>
+    double
+    project_fst<fst_type>::weight(typename project_fst<fst_type>::edge e) const
+    {
+        return fst_.weight(e);
+    }
+
+    template <class fst_type>
+    typename project_fst<fst_type>::input_symbol const&
+    project_fst<fst_type>::input(typename project_fst<fst_type>::edge e) const
+    {
+        if (side == project_side::input) {
+            return fst_.input(e);
+        } else {
+            return fst_.output(e);
+        }
+    }
+
+    template <class fst_type>
+    typename project_fst<fst_type>::output_symbol const&
+    project_fst<fst_type>::output(typename project_fst<fst_type>::edge e) const
+    {
+        if (side == project_side::input) {
+            return fst_.input(e);
+        } else {
+            return fst_.output(e);
+        }
+    }
+
+    template <class fst_type>
+    long
+    project_fst<fst_type>::time(typename project_fst<fst_type>::vertex v) const
+    {
+        return fst_.time(v);
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename project_fst<fst_type>::input_symbol,
+        std::vector<typename project_fst<fst_type>::edge>> const&
+    project_fst<fst_type>::in_edges_input_map(
+        typename project_fst<fst_type>::vertex v) const
+    {
+        if (side == project_side::input) {
+            return fst_.in_edges_input_map(v);
+        } else {
+            return fst_.in_edges_output_map(v);
+        }
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename project_fst<fst_type>::output_symbol,
+        std::vector<typename project_fst<fst_type>::edge>> const&
+    project_fst<fst_type>::in_edges_output_map(
+        typename project_fst<fst_type>::vertex v) const
+    {
+        if (side == project_side::input) {
+            return fst_.in_edges_input_map(v);
+        } else {
+            return fst_.in_edges_output_map(v);
+        }
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename project_fst<fst_type>::input_symbol,
+        std::vector<typename project_fst<fst_type>::edge>> const&
+    project_fst<fst_type>::out_edges_input_map(
+        typename project_fst<fst_type>::vertex v) const
+    {
+        if (side == project_side::input) {
+            return fst_.out_edges_input_map(v);
+        } else {
+            return fst_.out_edges_output_map(v);
+        }
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename project_fst<fst_type>::output_symbol,
+        std::vector<typename project_fst<fst_type>::edge>> const&
+    project_fst<fst_type>::out_edges_output_map(
+        typename project_fst<fst_type>::vertex v) const
+    {
+        if (side == project_side::input) {
+            return fst_.out_edges_input_map(v);
+        } else {
+            return fst_.out_edges_output_map(v);
+        }
+    }
+
+    template <class fst_type>
+    relabel_fst<fst_type>::relabel_fst(fst_type f,
+            std::shared_ptr<std::unordered_map<input_symbol, input_symbol> const> input_map,
+            std::shared_ptr<std::unordered_map<output_symbol, output_symbol> const> output_map)
+        : fst_(f), input_map(input_map), output_map(output_map)
+    {}
+
+    template <class fst_type>
+    std::vector<typename relabel_fst<fst_type>::vertex> const&
+    relabel_fst<fst_type>::vertices() const
+    {
+        return fst_.vertices();
+    }
+
+    template <class fst_type>
+    std::vector<typename relabel_fst<fst_type>::edge> const&
+    relabel_fst<fst_type>::edges() const
+    {
+        return fst_.edges();
+    }
+
+    template <class fst_type>
+    typename relabel_fst<fst_type>::vertex
+    relabel_fst<fst_type>::tail(typename relabel_fst<fst_type>::edge e) const
+    {
+        return fst_.tail(e);
+    }
+
+    template <class fst_type>
+    typename relabel_fst<fst_type>::vertex
+    relabel_fst<fst_type>::head(typename relabel_fst<fst_type>::edge e) const
+    {
+        return fst_.head(e);
+    }
+
+    template <class fst_type>
+    std::vector<typename relabel_fst<fst_type>::edge> const&
+    relabel_fst<fst_type>::in_edges(typename relabel_fst<fst_type>::vertex v) const
+    {
+        return fst_.in_edges(v);
+    }
+
+    template <class fst_type>
+    std::vector<typename relabel_fst<fst_type>::edge> const&
+    relabel_fst<fst_type>::out_edges(typename relabel_fst<fst_type>::vertex v) const
+    {
+        return fst_.out_edges(v);
+    }
+
+    template <class fst_type>
+    std::vector<typename relabel_fst<fst_type>::vertex> const&
+    relabel_fst<fst_type>::initials() const
+    {
+        return fst_.initials();
+    }
+
+    template <class fst_type>
+    std::vector<typename relabel_fst<fst_type>::vertex> const&
+    relabel_fst<fst_type>::finals() const
+    {
+        return fst_.finals();
+    }
+
+    template <class fst_type>
+    double
+    relabel_fst<fst_type>::weight(typename relabel_fst<fst_type>::edge e) const
+    {
+        return fst_.weight(e);
+    }
+
+    template <class fst_type>
+    typename relabel_fst<fst_type>::input_symbol const&
+    relabel_fst<fst_type>::input(typename relabel_fst<fst_type>::edge e) const
+    {
+        auto& s = fst_.input(e);
+
+        if (input_map != nullptr) {
+            auto iter = input_map->find(s);
+
+            if (iter != input_map->end()) {
+                return iter->second;
+            }
+        }
+
+        return s;
+    }
+
+    template <class fst_type>
+    typename relabel_fst<fst_type>::output_symbol const&
+    relabel_fst<fst_type>::output(typename relabel_fst<fst_type>::edge e) const
+    {
+        auto& s = fst_.output(e);
+
+        if (output_map != nullptr) {
+            auto iter = output_map->find(s);
+
+            if (iter != output_map->end()) {
+                return iter->second;
+            }
+        }
+
+        return s;
+    }
+
+    template <class fst_type>
+    long
+    relabel_fst<fst_type>::time(typename relabel_fst<fst_type>::vertex v) const
+    {
+        return fst_.time(v);
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename relabel_fst<fst_type>::input_symbol,
+        std::vector<typename relabel_fst<fst_type>::edge>> const&
+    relabel_fst<fst_type>::in_edges_input_map(
+        typename relabel_fst<fst_type>::vertex v) const
+    {
+        if (in_edges_input_map_vertex == nullptr || *in_edges_input_map_vertex != v) {
+            in_edges_input_map_cache.clear();
+
+            for (auto& e: fst_.in_edges(v)) {
+                in_edges_input_map_cache[input(e)].push_back(e);
+            }
+
+            in_edges_input_map_vertex = std::make_shared<vertex>(v);
+        }
+
+        return in_edges_input_map_cache;
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename relabel_fst<fst_type>::output_symbol,
+        std::vector<typename relabel_fst<fst_type>::edge>> const&
+    relabel_fst<fst_type>::in_edges_output_map(
+        typename relabel_fst<fst_type>::vertex v) const
+    {
+        if (in_edges_output_map_vertex == nullptr || *in_edges_output_map_vertex != v) {
+            in_edges_output_map_cache.clear();
+
+            for (auto& e: fst_.in_edges(v)) {
+                in_edges_output_map_cache[output(e)].push_back(e);
+            }
+
+            in_edges_output_map_vertex = std::make_shared<vertex>(v);
+        }
+
+        return in_edges_output_map_cache;
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename relabel_fst<fst_type>::input_symbol,
+        std::vector<typename relabel_fst<fst_type>::edge>> const&
+    relabel_fst<fst_type>::out_edges_input_map(
+        typename relabel_fst<fst_type>::vertex v) const
+    {
+        if (out_edges_input_map_vertex == nullptr || *out_edges_input_map_vertex != v) {
+            out_edges_input_map_cache.clear();
+
+            for (auto& e: fst_.out_edges(v)) {
+                out_edges_input_map_cache[input(e)].push_back(e);
+            }
+
+            out_edges_input_map_vertex = std::make_shared<vertex>(v);
+        }
+
+        return out_edges_input_map_cache;
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename relabel_fst<fst_type>::output_symbol,
+        std::vector<typename relabel_fst<fst_type>::edge>> const&
+    relabel_fst<fst_type>::out_edges_output_map(
+        typename relabel_fst<fst_type>::vertex v) const
+    {
+        if (out_edges_output_map_vertex == nullptr || *out_edges_output_map_vertex != v) {
+            out_edges_output_map_cache.clear();
+
+            for (auto& e: fst_.out_edges(v)) {
+                out_edges_output_map_cache[output(e)].push_back(e);
+            }
+
+            out_edges_output_map_vertex = std::make_shared<vertex>(v);
+        }
+
+        return out_edges_output_map_cache;
+    }
+
+    template <class fst_type>
+    scaled_fst<fst_type>::scaled_fst(fst_type f, double scale, double offset)
+        : fst_(f), scale(scale), offset(offset)
+    {}
+
+    template <class fst_type>
+    std::vector<typename scaled_fst<fst_type>::vertex> const&
+    scaled_fst<fst_type>::vertices() const
+    {
+        return fst_.vertices();
+    }
+
+    template <class fst_type>
+    std::vector<typename scaled_fst<fst_type>::edge> const&
+    scaled_fst<fst_type>::edges() const
+    {
+        return fst_.edges();
+    }
+
+    template <class fst_type>
+    typename scaled_fst<fst_type>::vertex
+    scaled_fst<fst_type>::tail(typename scaled_fst<fst_type>::edge e) const
+    {
+        return fst_.tail(e);
+    }
+
+    template <class fst_type>
+    typename scaled_fst<fst_type>::vertex
+    scaled_fst<fst_type>::head(typename scaled_fst<fst_type>::edge e) const
+    {
+        return fst_.head(e);
+    }
+
+    template <class fst_type>
+    std::vector<typename scaled_fst<fst_type>::edge> const&
+    scaled_fst<fst_type>::in_edges(typename scaled_fst<fst_type>::vertex v) const
+    {
+        return fst_.in_edges(v);
+    }
+
+    template <class fst_type>
+    std::vector<typename scaled_fst<fst_type>::edge> const&
+    scaled_fst<fst_type>::out_edges(typename scaled_fst<fst_type>::vertex v) const
+    {
+        return fst_.out_edges(v);
+    }
+
+    template <class fst_type>
+    std::vector<typename scaled_fst<fst_type>::vertex> const&
+    scaled_fst<fst_type>::initials() const
+    {
+        return fst_.initials();
+    }
+
+    template <class fst_type>
+    std::vector<typename scaled_fst<fst_type>::vertex> const&
+    scaled_fst<fst_type>::finals() const
+    {
+        return fst_.finals();
+    }
+
+    template <class fst_type>
+    double
+    scaled_fst<fst_type>::weight(typename scaled_fst<fst_type>::edge e) const
+    {
+        return scale * fst_.weight(e) + offset;
+    }
+
+    template <class fst_type>
+    typename scaled_fst<fst_type>::input_symbol const&
+    scaled_fst<fst_type>::input(typename scaled_fst<fst_type>::edge e) const
+    {
+        return fst_.input(e);
+    }
+
+    template <class fst_type>
+    typename scaled_fst<fst_type>::output_symbol const&
+    scaled_fst<fst_type>::output(typename scaled_fst<fst_type>::edge e) const
+    {
+        return fst_.output(e);
+    }
+
+    template <class fst_type>
+    long
+    scaled_fst<fst_type>::time(typename scaled_fst<fst_type>::vertex v) const
+    {
+        return fst_.time(v);
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename scaled_fst<fst_type>::input_symbol,
+        std::vector<typename scaled_fst<fst_type>::edge>> const&
+    scaled_fst<fst_type>::in_edges_input_map(
+        typename scaled_fst<fst_type>::vertex v) const
+    {
+        return fst_.in_edges_input_map(v);
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename scaled_fst<fst_type>::output_symbol,
+        std::vector<typename scaled_fst<fst_type>::edge>> const&
+    scaled_fst<fst_type>::in_edges_output_map(
+        typename scaled_fst<fst_type>::vertex v) const
+    {
+        return fst_.in_edges_output_map(v);
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename scaled_fst<fst_type>::input_symbol,
+        std::vector<typename scaled_fst<fst_type>::edge>> const&
+    scaled_fst<fst_type>::out_edges_input_map(
+        typename scaled_fst<fst_type>::vertex v) const
+    {
+        return fst_.out_edges_input_map(v);
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename scaled_fst<fst_type>::output_symbol,
+        std::vector<typename scaled_fst<fst_type>::edge>> const&
+    scaled_fst<fst_type>::out_edges_output_map(
+        typename scaled_fst<fst_type>::vertex v) const
+    {
+        return fst_.out_edges_output_map(v);
+    }
+
+
+    template <class fst_type>
+    subgraph_fst<fst_type>::subgraph_fst(fst_type f,
+            std::shared_ptr<std::vector<bool> const> vertex_mask,
+            std::shared_ptr<std::vector<bool> const> edge_mask)
+        : fst_(f), vertex_mask(vertex_mask), edge_mask(edge_mask)
+    {
+        in_edges_cache.resize(vertex_mask->size());
+        in_edges_done.resize(vertex_mask->size());
+        out_edges_cache.resize(vertex_mask->size());
+        out_edges_done.resize(vertex_mask->size());
+    }
+
+    template <class fst_type>
+    subgraph_fst<fst_type>::subgraph_fst(fst_type f,
+            std::vector<typename subgraph_fst<fst_type>::edge> const& retained_edges)
+        : fst_(f)
+    {
+        auto v_mask = std::make_shared<std::vector<bool>>();
+        auto e_mask = std::make_shared<std::vector<bool>>();
+
+        auto set = [](std::vector<bool>& mask, int i) {
+            if (i >= mask.size()) {
+                mask.resize(i + 1);
+            }
+
+            mask[i] = true;
+        };
+
+        for (auto& e: retained_edges) {
+            set(*e_mask, e);
+            set(*v_mask, f.tail(e));
+            set(*v_mask, f.head(e));
+        }
+
+        for (auto& v: f.initials()) {
+            set(*v_mask, v);
+        }
+
+        for (auto& v: f.finals()) {
+            set(*v_mask, v);
+        }
+
+        vertex_mask = v_mask;
+        edge_mask = e_mask;
+
+        in_edges_cache.resize(vertex_mask->size());
+        in_edges_done.resize(vertex_mask->size());
+        out_edges_cache.resize(vertex_mask->size());
+        out_edges_done.resize(vertex_mask->size());
+    }
+
+    template <class fst_type>
+    bool subgraph_fst<fst_type>::has_vertex(typename subgraph_fst<fst_type>::vertex v) const
+    {
+        return v < vertex_mask->size() && (*vertex_mask)[v];
+    }
+
+    template <class fst_type>
+    bool subgraph_fst<fst_type>::has_edge(typename subgraph_fst<fst_type>::edge e) const
+    {
+        return e < edge_mask->size() && (*edge_mask)[e]
+            && has_vertex(fst_.tail(e)) && has_vertex(fst_.head(e));
+    }
+
+    template <class fst_type>
+    std::vector<typename subgraph_fst<fst_type>::vertex> const&
+    subgraph_fst<fst_type>::vertices() const
+    {
+        if (vertices_cache == nullptr) {
+            vertices_cache = std::make_shared<std::vector<vertex>>();
+
+            for (auto& v: fst_.vertices()) {
+                if (has_vertex(v)) {
+                    vertices_cache->push_back(v);
+                }
+            }
+        }
+
+        return *vertices_cache;
+    }
+
+    template <class fst_type>
+    std::vector<typename subgraph_fst<fst_type>::edge> const&
+    subgraph_fst<fst_type>::edges() const
+    {
+        if (edges_cache == nullptr) {
+            edges_cache = std::make_shared<std::vector<edge>>();
+
+            for (auto& e: fst_.edges()) {
+                if (has_edge(e)) {
+                    edges_cache->push_back(e);
+                }
+            }
+        }
+
+        return *edges_cache;
+    }
+
+    template <class fst_type>
+    typename subgraph_fst<fst_type>::vertex
+    subgraph_fst<fst_type>::tail(typename subgraph_fst<fst_type>::edge e) const
+    {
+        return fst_.tail(e);
+    }
+
+    template <class fst_type>
+    typename subgraph_fst<fst_type>::vertex
+    subgraph_fst<fst_type>::head(typename subgraph_fst<fst_type>::edge e) const
+    {
+        return fst_.head(e);
+    }
+
+    template <class fst_type>
+    std::vector<typename subgraph_fst<fst_type>::edge> const&
+    subgraph_fst<fst_type>::in_edges(typename subgraph_fst<fst_type>::vertex v) const
+    {
+        // The tables are sized once by the constructors, so lists
+        // handed out stay where they are.  Vertices past the mask are
+        // not in the subgraph.
+
+        if (v >= in_edges_cache.size()) {
+            return empty_edges;
+        }
+
+        if (!in_edges_done[v]) {
+            for (auto& e: fst_.in_edges(v)) {
+                if (has_edge(e)) {
+                    in_edges_cache[v].push_back(e);
+                }
+            }
+
+            in_edges_done[v] = true;
+        }
+
+        return in_edges_cache[v];
+    }
+
+    template <class fst_type>
+    std::vector<typename subgraph_fst<fst_type>::edge> const&
+    subgraph_fst<fst_type>::out_edges(typename subgraph_fst<fst_type>::vertex v) const
+    {
+        if (v >= out_edges_cache.size()) {
+            return empty_edges;
+        }
+
+        if (!out_edges_done[v]) {
+            for (auto& e: fst_.out_edges(v)) {
+                if (has_edge(e)) {
+                    out_edges_cache[v].push_back(e);
+                }
+            }
+
+            out_edges_done[v] = true;
+        }
+
+        return out_edges_cache[v];
+    }
+
+    template <class fst_type>
+    std::vector<typename subgraph_fst<fst_type>::vertex> const&
+    subgraph_fst<fst_type>::initials() const
+    {
+        if (initials_cache == nullptr) {
+            initials_cache = std::make_shared<std::vector<vertex>>();
+
+            for (auto& v: fst_.initials()) {
+                if (has_vertex(v)) {
+                    initials_cache->push_back(v);
+                }
+            }
+        }
+
+        return *initials_cache;
+    }
+
+    template <class fst_type>
+    std::vector<typename subgraph_fst<fst_type>::vertex> const&
+    subgraph_fst<fst_type>::finals() const
+    {
+        if (finals_cache == nullptr) {
+            finals_cache = std::make_shared<std::vector<vertex>>();
+
+            for (auto& v: fst_.finals()) {
+                if (has_vertex(v)) {
+                    finals_cache->push_back(v);
+                }
+            }
+        }
+
+        return *finals_cache;
+    }
+
+    template <class fst_type>
+    double subgraph_fst<fst_type>::weight(typename subgraph_fst<fst_type>::edge e) const
+    {
+        return fst_.weight(e);
+    }
+
+    template <class fst_type>
+    typename subgraph_fst<fst_type>::input_symbol const&
+    subgraph_fst<fst_type>::input(typename subgraph_fst<fst_type>::edge e) const
+    {
+        return fst_.input(e);
+    }
+
+    template <class fst_type>
+    typename subgraph_fst<fst_type>::output_symbol const&
+    subgraph_fst<fst_type>::output(typename subgraph_fst<fst_type>::edge e) const
+    {
+        return fst_.output(e);
+    }
+
+    template <class fst_type>
+    long subgraph_fst<fst_type>::time(typename subgraph_fst<fst_type>::vertex v) const
+    {
+        return fst_.time(v);
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename subgraph_fst<fst_type>::input_symbol,
+        std::vector<typename subgraph_fst<fst_type>::edge>> const&
+    subgraph_fst<fst_type>::in_edges_input_map(
+        typename subgraph_fst<fst_type>::vertex v) const
+    {
+        if (in_edges_input_map_vertex == nullptr || *in_edges_input_map_vertex != v) {
+            in_edges_input_map_cache.clear();
+
+            for (auto& e: in_edges(v)) {
+                in_edges_input_map_cache[fst_.input(e)].push_back(e);
+            }
+
+            in_edges_input_map_vertex = std::make_shared<vertex>(v);
+        }
+
+        return in_edges_input_map_cache;
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename subgraph_fst<fst_type>::output_symbol,
+        std::vector<typename subgraph_fst<fst_type>::edge>> const&
+    subgraph_fst<fst_type>::in_edges_output_map(
+        typename subgraph_fst<fst_type>::vertex v) const
+    {
+        if (in_edges_output_map_vertex == nullptr || *in_edges_output_map_vertex != v) {
+            in_edges_output_map_cache.clear();
+
+            for (auto& e: in_edges(v)) {
+                in_edges_output_map_cache[fst_.output(e)].push_back(e);
+            }
+
+            in_edges_output_map_vertex = std::make_shared<vertex>(v);
+        }
+
+        return in_edges_output_map_cache;
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename subgraph_fst<fst_type>::input_symbol,
+        std::vector<typename subgraph_fst<fst_type>::edge>> const&
+    subgraph_fst<fst_type>::out_edges_input_map(
+        typename subgraph_fst<fst_type>::vertex v) const
+    {
+        if (out_edges_input_map_vertex == nullptr || *out_edges_input_map_vertex != v) {
+            out_edges_input_map_cache.clear();
+
+            for (auto& e: out_edges(v)) {
+                out_edges_input_map_cache[fst_.input(e)].push_back(e);
+            }
+
+            out_edges_input_map_vertex = std::make_shared<vertex>(v);
+        }
+
+        return out_edges_input_map_cache;
+    }
+
+    template <class fst_type>
+    std::unordered_map<typename subgraph_fst<fst_type>::output_symbol,
+        std::vector<typename subgraph_fst<fst_type>::edge>> const&
+    subgraph_fst<fst_type>::out_edges_output_map(
+        typename subgraph_fst<fst_type>::vertex v) const
+    {
+        if (out_edges_output_map_vertex == nullptr || *out_edges_output_map_vertex != v) {
+            out_edges_output_map_cache.clear();
+
+            for (auto& e: out_edges(v)) {
+                out_edges_output_map_cache[fst_.output(e)].push_back(e);
+            }
+
+            out_edges_output_map_vertex = std::make_shared<vertex>(v);
+        }
+
+        return out_edges_output_map_cache;
+    }
+
+}
@@ -0,0 +1,383 @@
+#ifndef FST_VIEW_H
+#define FST_VIEW_H
+
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "fst/fst.h"
+
+namespace fst {
+
+    /*
+     * Views wrap an fst and present it differently without copying it.
+     * They forward to the wrapped fst and return its vectors by
+     * reference, so queries allocate nothing, except for the relabeled
+     * edge maps of `relabel_fst`, which are cached for one vertex as in
+     * `lazy_pair_fst`.  Members such as `time` and the edge maps are
+     * only instantiated when used, so a view works over any fst that
+     * has what its caller needs.
+     *
+     */
+
+    /*
+     * The wrapped fst with every edge reversed.  Initials and finals
+     * are swapped, and `time` is negated so that it still increases
+     * along edges.  Running a forward algorithm on the reversed fst
+     * gives the backward result, e.g., `forward_one_best` on
+     * `reverse_fst<F>` computes what `backward_one_best` computes on `F`.
+     *
+     */
+    template <class fst_type>
+    struct reverse_fst {
+
+        using vertex = typename fst_type::vertex;
+        using edge = typename fst_type::edge;
+        using input_symbol = typename fst_type::input_symbol;
+        using output_symbol = typename fst_type::output_symbol;
+
+        fst_type fst_;
+
+        reverse_fst(fst_type f);
+
+        std::vector<vertex> const& vertices() const;
+        std::vector<edge> const& edges() const;
+        vertex tail(edge e) const;
+        vertex head(edge e) const;
+        std::vector<edge> const& in_edges(vertex v) const;
+        std::vector<edge> const& out_edges(vertex v) const;
+        std::vector<vertex> const& initials() const;
+        std::vector<vertex> const& finals() const;
+        double weight(edge e) const;
+        input_symbol const& input(edge e) const;
+        output_symbol const& output(edge e) const;
+
+        long time(vertex v) const;
+
+        std::unordered_map<input_symbol, std::vector<edge>> const&
+        in_edges_input_map(vertex v) const;
+
+        std::unordered_map<output_symbol, std::vector<edge>> const&
+        in_edges_output_map(vertex v) const;
+
+        std::unordered_map<input_symbol, std::vector<edge>> const&
+        out_edges_input_map(vertex v) const;
+
+        std::unordered_map<output_symbol, std::vector<edge>> const&
+        out_edges_output_map(vertex v) const;
+
+    };
+
+    template <class fst_type>
+    struct fst_trait<reverse_fst<fst_type>> {
+        using vertex = typename reverse_fst<fst_type>::vertex;
+        using edge = typename reverse_fst<fst_type>::edge;
+        using input_symbol = typename reverse_fst<fst_type>::input_symbol;
+        using output_symbol = typename reverse_fst<fst_type>::output_symbol;
+    };
+
+    enum class project_side {
+        input,
+        output
+    };
+
+    /*
+     * The wrapped fst as an acceptor, with both the input and the
+     * output of every edge being the input (or the output) of the
+     * wrapped edge.  Input and output symbols must have the same type.
+     *
+     */
+    template <class fst_type>
+    struct project_fst {
+
+        using vertex = typename fst_type::vertex;
+        using edge = typename fst_type::edge;
+        using input_symbol = typename fst_type::input_symbol;
+        using output_symbol = typename fst_type::output_symbol;
+
+        static_assert(std::is_same<input_symbol, output_symbol>::value,
+            "project_fst needs the same input and output symbol type");
+
+        fst_type fst_;
+        project_side side;
+
+        project_fst(fst_type f, project_side side);
+
+        std::vector<vertex> const& vertices() const;
+        std::vector<edge> const& edges() const;
+        vertex tail(edge e) const;
+        vertex head(edge e) const;
+        std::vector<edge> const& in_edges(vertex v) const;
+        std::vector<edge> const& out_edges(vertex v) const;
+        std::vector<vertex> const& initials() const;
+        std::vector<vertex> const& finals() const;
+        double weight(edge e) const;
+        input_symbol const& input(edge e) const;
+        output_symbol const& output(edge e) const;
+
+        long time(vertex v) const;
+
+        std::unordered_map<input_symbol, std::vector<edge>> const&
+        in_edges_input_map(vertex v) const;
+
+        std::unordered_map<output_symbol, std::vector<edge>> const&
+        in_edges_output_map(vertex v) const;
+
+        std::unordered_map<input_symbol, std::vector<edge>> const&
+        out_edges_input_map(vertex v) const;
+
+        std::unordered_map<output_symbol, std::vector<edge>> const&
+        out_edges_output_map(vertex v) const;
+
+    };
+
+    template <class fst_type>
+    struct fst_trait<project_fst<fst_type>> {
+        using vertex = typename project_fst<fst_type>::vertex;
+        using edge = typename project_fst<fst_type>::edge;
+        using input_symbol = typename project_fst<fst_type>::input_symbol;
+        using output_symbol = typename project_fst<fst_type>::output_symbol;
+    };
+
+    /*
+     * The wrapped fst with input and output symbols mapped through
+     * `input_map` and `output_map`.  Symbols missing from a map (or
+     * all symbols, if the map is null) are left as they are.  The maps
+     * are shared, not copied.
+     *
+     * The edge maps have to be regrouped by the new symbols, so each
+     * one is built for the last vertex asked for and kept until a
+     * different vertex is asked for.
+     *
+     */
+    template <class fst_type>
+    struct relabel_fst {
+
+        using vertex = typename fst_type::vertex;
+        using edge = typename fst_type::edge;
+        using input_symbol = typename fst_type::input_symbol;
+        using output_symbol = typename fst_type::output_symbol;
+
+        fst_type fst_;
+
+        std::shared_ptr<std::unordered_map<input_symbol, input_symbol> const> input_map;
+        std::shared_ptr<std::unordered_map<output_symbol, output_symbol> const> output_map;
+
+        mutable std::shared_ptr<vertex> in_edges_input_map_vertex;
+        mutable std::unordered_map<input_symbol, std::vector<edge>> in_edges_input_map_cache;
+
+        mutable std::shared_ptr<vertex> in_edges_output_map_vertex;
+        mutable std::unordered_map<output_symbol, std::vector<edge>> in_edges_output_map_cache;
+
+        mutable std::shared_ptr<vertex> out_edges_input_map_vertex;
+        mutable std::unordered_map<input_symbol, std::vector<edge>> out_edges_input_map_cache;
+
+        mutable std::shared_ptr<vertex> out_edges_output_map_vertex;
+        mutable std::unordered_map<output_symbol, std::vector<edge>> out_edges_output_map_cache;
+
+        relabel_fst(fst_type f,
+            std::shared_ptr<std::unordered_map<input_symbol, input_symbol> const> input_map,
+            std::shared_ptr<std::unordered_map<output_symbol, output_symbol> const> output_map);
+
+        std::vector<vertex> const& vertices() const;
+        std::vector<edge> const& edges() const;
+        vertex tail(edge e) const;
+        vertex head(edge e) const;
+        std::vector<edge> const& in_edges(vertex v) const;
+        std::vector<edge> const& out_edges(vertex v) const;
+        std::vector<vertex> const& initials() const;
+        std::vector<vertex> const& finals() const;
+        double weight(edge e) const;
+        input_symbol const& input(edge e) const;
+        output_symbol const& output(edge e) const;
+
+        long time(vertex v) const;
+
+        std::unordered_map<input_symbol, std::vector<edge>> const&
+        in_edges_input_map(vertex v) const;
+
+        std::unordered_map<output_symbol, std::vector<edge>> const&
+        in_edges_output_map(vertex v) const;
+
+        std::unordered_map<input_symbol, std::vector<edge>> const&
+        out_edges_input_map(vertex v) const;
+
+        std::unordered_map<output_symbol, std::vector<edge>> const&
+        out_edges_output_map(vertex v) const;
+
+    };
+
+    template <class fst_type>
+    struct fst_trait<relabel_fst<fst_type>> {
+        using vertex = typename relabel_fst<fst_type>::vertex;
+        using edge = typename relabel_fst<fst_type>::edge;
+        using input_symbol = typename relabel_fst<fst_type>::input_symbol;
+        using output_symbol = typename relabel_fst<fst_type>::output_symbol;
+    };
+
+    /*
+     * The wrapped fst with every weight `w` replaced by
+     * `scale * w + offset`, e.g., to apply an acoustic scale or a
+     * word insertion penalty.
+     *
+     */
+    template <class fst_type>
+    struct scaled_fst {
+
+        using vertex = typename fst_type::vertex;
+        using edge = typename fst_type::edge;
+        using input_symbol = typename fst_type::input_symbol;
+        using output_symbol = typename fst_type::output_symbol;
+
+        fst_type fst_;
+        double scale;
+        double offset;
+
+        scaled_fst(fst_type f, double scale, double offset = 0);
+
+        std::vector<vertex> const& vertices() const;
+        std::vector<edge> const& edges() const;
+        vertex tail(edge e) const;
+        vertex head(edge e) const;
+        std::vector<edge> const& in_edges(vertex v) const;
+        std::vector<edge> const& out_edges(vertex v) const;
+        std::vector<vertex> const& initials() const;
+        std::vector<vertex> const& finals() const;
+        double weight(edge e) const;
+        input_symbol const& input(edge e) const;
+        output_symbol const& output(edge e) const;
+
+        long time(vertex v) const;
+
+        std::unordered_map<input_symbol, std::vector<edge>> const&
+        in_edges_input_map(vertex v) const;
+
+        std::unordered_map<output_symbol, std::vector<edge>> const&
+        in_edges_output_map(vertex v) const;
+
+        std::unordered_map<input_symbol, std::vector<edge>> const&
+        out_edges_input_map(vertex v) const;
+
+        std::unordered_map<output_symbol, std::vector<edge>> const&
+        out_edges_output_map(vertex v) const;
+
+    };
+
+    template <class fst_type>
+    struct fst_trait<scaled_fst<fst_type>> {
+        using vertex = typename scaled_fst<fst_type>::vertex;
+        using edge = typename scaled_fst<fst_type>::edge;
+        using input_symbol = typename scaled_fst<fst_type>::input_symbol;
+        using output_symbol = typename scaled_fst<fst_type>::output_symbol;
+    };
+
+    /*
+     * The part of the wrapped fst selected by a vertex mask and an
+     * edge mask, both indexed by id, so vertices and edges must be
+     * integers (e.g., `ifst::fst` or a view of it).  An edge is kept if
+     * it and both of its ends are in the masks.  The masks are shared,
+     * so one mask can be applied to several fsts without copying.
+     *
+     * Filtered adjacency lists are built the first time a vertex is
+     * asked for and kept, so later passes cost the same as on a
+     * compact fst.  They live in tables sized by the vertex mask when
+     * the view is built, so references to them stay valid, as with
+     * `ifst::fst`.  Filtered edge maps are kept for the last vertex
+     * asked for, as in `relabel_fst`.
+     *
+     * Nesting views gives prune, rescore and prune again without
+     * building a new fst.
+     *
+     */
+    template <class fst_type>
+    struct subgraph_fst {
+
+        using vertex = typename fst_type::vertex;
+        using edge = typename fst_type::edge;
+        using input_symbol = typename fst_type::input_symbol;
+        using output_symbol = typename fst_type::output_symbol;
+
+        static_assert(std::is_integral<vertex>::value && std::is_integral<edge>::value,
+            "subgraph_fst needs integer vertices and edges");
+
+        fst_type fst_;
+
+        std::shared_ptr<std::vector<bool> const> vertex_mask;
+        std::shared_ptr<std::vector<bool> const> edge_mask;
+
+        mutable std::shared_ptr<std::vector<vertex>> vertices_cache;
+        mutable std::shared_ptr<std::vector<edge>> edges_cache;
+        mutable std::shared_ptr<std::vector<vertex>> initials_cache;
+        mutable std::shared_ptr<std::vector<vertex>> finals_cache;
+
+        mutable std::vector<std::vector<edge>> in_edges_cache;
+        mutable std::vector<bool> in_edges_done;
+        mutable std::vector<std::vector<edge>> out_edges_cache;
+        mutable std::vector<bool> out_edges_done;
+        std::vector<edge> empty_edges;
+
+        mutable std::shared_ptr<vertex> in_edges_input_map_vertex;
+        mutable std::unordered_map<input_symbol, std::vector<edge>> in_edges_input_map_cache;
+
+        mutable std::shared_ptr<vertex> in_edges_output_map_vertex;
+        mutable std::unordered_map<output_symbol, std::vector<edge>> in_edges_output_map_cache;
+
+        mutable std::shared_ptr<vertex> out_edges_input_map_vertex;
+        mutable std::unordered_map<input_symbol, std::vector<edge>> out_edges_input_map_cache;
+
+        mutable std::shared_ptr<vertex> out_edges_output_map_vertex;
+        mutable std::unordered_map<output_symbol, std::vector<edge>> out_edges_output_map_cache;
+
+        subgraph_fst(fst_type f, std::shared_ptr<std::vector<bool> const> vertex_mask,
+            std::shared_ptr<std::vector<bool> const> edge_mask);
+
+        /*
+         * Keeps the edges in `retained_edges`, e.g., from `beam_prune`,
+         * their ends, and the initial and final vertices.
+         */
+        subgraph_fst(fst_type f, std::vector<edge> const& retained_edges);
+
+        bool has_vertex(vertex v) const;
+        bool has_edge(edge e) const;
+
+        std::vector<vertex> const& vertices() const;
+        std::vector<edge> const& edges() const;
+        vertex tail(edge e) const;
+        vertex head(edge e) const;
+        std::vector<edge> const& in_edges(vertex v) const;
+        std::vector<edge> const& out_edges(vertex v) const;
+        std::vector<vertex> const& initials() const;
+        std::vector<vertex> const& finals() const;
+        double weight(edge e) const;
+        input_symbol const& input(edge e) const;
+        output_symbol const& output(edge e) const;
+
+        long time(vertex v) const;
+
+        std::unordered_map<input_symbol, std::vector<edge>> const&
+        in_edges_input_map(vertex v) const;
+
+        std::unordered_map<output_symbol, std::vector<edge>> const&
+        in_edges_output_map(vertex v) const;
+
+        std::unordered_map<input_symbol, std::vector<edge>> const&
+        out_edges_input_map(vertex v) const;
+
+        std::unordered_map<output_symbol, std::vector<edge>> const&
+        out_edges_output_map(vertex v) const;
+
+    };
+
+    template <class fst_type>
+    struct fst_trait<subgraph_fst<fst_type>> {
+        using vertex = typename subgraph_fst<fst_type>::vertex;
+        using edge = typename subgraph_fst<fst_type>::edge;
+        using input_symbol = typename subgraph_fst<fst_type>::input_symbol;
+        using output_symbol = typename subgraph_fst<fst_type>::output_symbol;
+    };
+
+}
+
+#include "fst/fst-view-impl.h"
+
+#endif
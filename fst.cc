@@ -4,4 +4,6 @@ namespace fst {
 
     std::string symbol_trait<std::string>::eps = "<eps>";
 
+    int symbol_trait<int>::eps = 0;
+
 }
@@ -2,6 +2,7 @@
 #define FST_H
 
 #include <unordered_map>
+#include <unordered_set>
 #include <tuple>
 #include <vector>
 #include <limits>
@@ -75,6 +76,11 @@ namespace fst {
         static std::string eps;
     };
 
+    template <>
+    struct symbol_trait<int> {
+        static int eps;
+    };
+
     /*
      * The class `edge_trait` is usefule for creating null edges.
      * Null edges are used, for example, in tracking back
@@ -131,6 +137,91 @@ namespace fst {
         using output_symbol = typename pair_fst<fst1, fst2>::output_symbol;
     };
 
+#if FST_STATS
+
+    /*
+     * Counters kept by `lazy_pair_fst` and its subclasses when compiled
+     * with `-DFST_STATS=1`.  Without it, none of the counting code is
+     * compiled.
+     *
+     * A query is a hit if it is answered from the single-vertex cache.
+     * `states_expanded` is the number of distinct vertices whose edges
+     * were computed, and `edges_expanded` the number of edges built,
+     * counting an edge again each time it is rebuilt.  `label_misses`
+     * counts edges of one side whose label has no edge on the other
+     * side in the label map.  `cache_bytes` is computed when `stats()`
+     * is called.
+     *
+     */
+    struct pair_fst_stats {
+
+        enum query {
+            in_edges,
+            out_edges,
+            in_edges_input_map,
+            in_edges_output_map,
+            out_edges_input_map,
+            out_edges_output_map,
+            nqueries
+        };
+
+        long hits[nqueries] = {};
+        long misses[nqueries] = {};
+
+        long states_expanded = 0;
+        long edges_expanded = 0;
+        long label_misses = 0;
+        long cache_bytes = 0;
+
+        void count(query q, bool hit)
+        {
+            if (hit) {
+                ++hits[q];
+            } else {
+                ++misses[q];
+            }
+        }
+
+        template <class edge>
+        void expanded(std::vector<edge> const& edges)
+        {
+            edges_expanded += edges.size();
+        }
+
+        template <class symbol, class edge>
+        void expanded(std::unordered_map<symbol, std::vector<edge>> const& map)
+        {
+            for (auto& p: map) {
+                edges_expanded += p.second.size();
+            }
+        }
+
+        template <class edge>
+        static long bytes(std::shared_ptr<std::vector<edge>> const& v)
+        {
+            return v == nullptr ? 0 : sizeof(std::vector<edge>) + v->capacity() * sizeof(edge);
+        }
+
+        template <class symbol, class edge>
+        static long bytes(std::shared_ptr<std::unordered_map<symbol, std::vector<edge>>> const& map)
+        {
+            if (map == nullptr) {
+                return 0;
+            }
+
+            long result = sizeof(*map) + map->bucket_count() * sizeof(void*);
+
+            for (auto& p: *map) {
+                result += sizeof(p) + sizeof(void*) + p.second.capacity() * sizeof(edge);
+            }
+
+            return result;
+        }
+
+    };
+
+#endif
+
     template <class fst1_type, class fst2_type>
     struct lazy_pair_fst
         : public pair_fst<fst1_type, fst2_type> {
@@ -168,6 +259,21 @@ namespace fst {
         mutable std::shared_ptr<std::unordered_map<output_symbol,
             std::vector<edge>>> out_edges_output_map_cache;
 
+#if FST_STATS
+        mutable pair_fst_stats stats_;
+        mutable std::unordered_set<vertex> stats_vertices;
+
+        pair_fst_stats stats() const;
+        void reset_stats();
+
+        /*
+         * Counts the edges in `result`, just computed for `v`, and `v`
+         * if it is new.
+         */
+        template <class container>
+        void note_expanded(vertex const& v, container const& result) const;
+#endif
+
         lazy_pair_fst(fst1_type fst1, fst2_type fst2);
 
         virtual std::vector<vertex> const& vertices() const override;
@@ -0,0 +1,1031 @@
+#include "fst/ifst.h"
+#include "fst/fst-algo.h"
+#include "fst/fst-batch.h"
+#include "fst/fst-view.h"
+#include "fst/ifst-algo.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+
+/*
+ * Differential fuzzing of the composition modes and the scoring
+ * engines.  Each case is a pair of random acyclic transducers.
+ *
+ *   - `lazy_pair_fst`, `lazy_pair_mode1_fst` and `lazy_pair_mode2_fst`
+ *     of the pair must have the same edges, in-edges, out-edges and
+ *     edge maps at every vertex.
+ *
+ *   - On the first transducer and on the composition, every engine
+ *     (path_sum-based one-best and log sum with each log-add, k-best,
+ *     beam search without a beam, shortest_distance with each queue
+ *     discipline, A*, token passing, the batch API) must agree with the
+ *     plain dynamic programs in this file.
+ *
+ *   - A `subgraph_fst` of the first transducer must have its filtered
+ *     adjacency lists, and lists handed out must stay valid while
+ *     other vertices are asked for.
+ *
+ *   - `determinize`, `lazy_determinized_fst`, `push_weights`,
+ *     `minimize`, `rm_eps` and `lazy_rm_eps_fst` of the first
+ *     transducer must give every label sequence the same best
+ *     (tropical) or total (log) score as the transducer itself, and
+ *     the epsilon removals must leave eps:eps edges only into final
+ *     vertices without out-edges.
+ *
+ * On the first failure the case is shrunk, by dropping edges and
+ * vertices as long as it still fails, and printed.
+ *
+ * Usage: fuzz [cases] [seed]
+ *
+ * The `OMP_SAFE` path of the log sums is only compiled with
+ * `-DOMP_SAFE=1 -fopenmp`, so run the fuzzer in that build as well
+ * before turning it on.
+ *
+ */
+
+namespace fst {
+
+    template <>
+    struct edge_trait<int> {
+        static int null;
+    };
+
+    int edge_trait<int>::null = -1;
+
+    template <>
+    struct edge_trait<std::tuple<int, int>> {
+        static std::tuple<int, int> null;
+    };
+
+    std::tuple<int, int> edge_trait<std::tuple<int, int>>::null = std::make_tuple(-1, -1);
+
+}
+
+/*
+ * A transducer as plain data, so that it can be shrunk.  Edges always
+ * go from a smaller vertex to a larger one, which keeps the graph
+ * acyclic and makes the vertex id a topological order and a time.
+ *
+ */
+struct graph {
+    int vertices;
+    std::vector<ifst::edge_data> edges;
+    std::vector<int> initials;
+    std::vector<int> finals;
+};
+
+ifst::fst make_fst(graph const& g)
+{
+    ifst::fst f;
+    f.data = std::make_shared<ifst::fst_data>();
+
+    for (int v = 0; v < g.vertices; ++v) {
+        ifst::add_vertex(*f.data, v, ifst::vertex_data { v });
+    }
+
+    for (int e = 0; e < g.edges.size(); ++e) {
+        ifst::add_edge(*f.data, e, g.edges[e]);
+    }
+
+    f.data->initials = g.initials;
+    f.data->finals = g.finals;
+
+    return f;
+}
+
+graph random_graph(std::mt19937& gen)
+{
+    std::uniform_int_distribution<int> nvertices { 1, 8 };
+    std::uniform_real_distribution<double> weight { -3, 0 };
+
+    graph g;
+    g.vertices = nvertices(gen);
+
+    std::uniform_int_distribution<int> vertex { 0, g.vertices - 1 };
+    std::uniform_int_distribution<int> nedges { 0, 3 * g.vertices };
+
+    // Labels 0 to 2, where 0 is eps, so that most edges find a match.
+    std::uniform_int_distribution<int> label { 0, 2 };
+
+    int n = nedges(gen);
+
+    for (int i = 0; i < n; ++i) {
+        int tail = vertex(gen);
+        int head = vertex(gen);
+
+        if (tail == head) {
+            continue;
+        }
+
+        g.edges.push_back(ifst::edge_data { std::min(tail, head), std::max(tail, head),
+            weight(gen), label(gen), label(gen) });
+    }
+
+    std::uniform_int_distribution<int> nends { 1, 2 };
+
+    for (int i = nends(gen); i > 0; --i) {
+        g.initials.push_back(vertex(gen));
+    }
+
+    for (int i = nends(gen); i > 0; --i) {
+        g.finals.push_back(vertex(gen));
+    }
+
+    std::sort(g.initials.begin(), g.initials.end());
+    g.initials.erase(std::unique(g.initials.begin(), g.initials.end()), g.initials.end());
+    std::sort(g.finals.begin(), g.finals.end());
+    g.finals.erase(std::unique(g.finals.begin(), g.finals.end()), g.finals.end());
+
+    return g;
+}
+
+void print(std::ostream& os, graph const& g)
+{
+    os << "vertices " << g.vertices << std::endl;
+
+    os << "initials";
+    for (auto& v: g.initials) {
+        os << " " << v;
+    }
+    os << std::endl;
+
+    os << "finals";
+    for (auto& v: g.finals) {
+        os << " " << v;
+    }
+    os << std::endl;
+
+    for (auto& e: g.edges) {
+        os << e.tail << " " << e.head << " " << e.input << ":" << e.output
+            << " " << e.weight << std::endl;
+    }
+}
+
+/*
+ * The plain dynamic programs that the engines are checked against.
+ * `order` must be a topological order, and `in_edges` is taken from
+ * the generic `lazy_pair_fst` for compositions.
+ *
+ */
+template <class fst_type>
+std::unordered_map<typename fst_type::vertex, double>
+reference_max(fst_type const& f, std::vector<typename fst_type::vertex> const& order)
+{
+    double inf = std::numeric_limits<double>::infinity();
+
+    std::unordered_map<typename fst_type::vertex, double> value;
+
+    for (auto& v: f.initials()) {
+        value[v] = 0;
+    }
+
+    for (auto& v: order) {
+        double max = ebt::in(v, value) ? value.at(v) : -inf;
+
+        for (auto& e: f.in_edges(v)) {
+            if (ebt::in(f.tail(e), value)) {
+                max = std::max(max, value.at(f.tail(e)) + f.weight(e));
+            }
+        }
+
+        if (max > -inf) {
+            value[v] = max;
+        }
+    }
+
+    return value;
+}
+
+template <class fst_type>
+std::unordered_map<typename fst_type::vertex, double>
+reference_log_sum(fst_type const& f, std::vector<typename fst_type::vertex> const& order)
+{
+    std::unordered_map<typename fst_type::vertex, double> value;
+
+    for (auto& v: f.initials()) {
+        value[v] = 0;
+    }
+
+    for (auto& v: order) {
+        std::vector<double> terms;
+
+        if (ebt::in(v, value)) {
+            terms.push_back(value.at(v));
+        }
+
+        for (auto& e: f.in_edges(v)) {
+            if (ebt::in(f.tail(e), value)) {
+                terms.push_back(value.at(f.tail(e)) + f.weight(e));
+            }
+        }
+
+        if (terms.size() == 0) {
+            continue;
+        }
+
+        double max = *std::max_element(terms.begin(), terms.end());
+        double sum = 0;
+
+        for (auto& t: terms) {
+            sum += std::exp(t - max);
+        }
+
+        value[v] = max + std::log(sum);
+    }
+
+    return value;
+}
+
+/*
+ * The scores of all paths from an initial to a final vertex, best
+ * first, or nothing if there are more than `limit`.
+ *
+ */
+template <class fst_type>
+std::vector<double> reference_paths(fst_type const& f, int limit)
+{
+    using vertex = typename fst_type::vertex;
+
+    std::unordered_set<vertex> final_set { f.finals().begin(), f.finals().end() };
+    std::vector<double> scores;
+    bool overflow = false;
+
+    std::function<void(vertex, double)> dfs = [&](vertex v, double score) {
+        if (overflow) {
+            return;
+        }
+
+        if (ebt::in(v, final_set)) {
+            scores.push_back(score);
+
+            if (scores.size() > limit) {
+                overflow = true;
+                return;
+            }
+        }
+
+        for (auto& e: f.out_edges(v)) {
+            dfs(f.head(e), score + f.weight(e));
+        }
+    };
+
+    for (auto& v: f.initials()) {
+        dfs(v, 0);
+    }
+
+    if (overflow) {
+        return std::vector<double> {};
+    }
+
+    std::sort(scores.begin(), scores.end(), std::greater<double>());
+
+    return scores;
+}
+
+/*
+ * The best (tropical) or total (log) score of each sequence of
+ * (input, output) pairs, with eps:eps pairs dropped, so that adding or
+ * removing epsilon edges does not change the key.  Sets `overflow` and
+ * stops if there are more than `limit` paths.
+ *
+ */
+template <class fst_type>
+std::map<std::vector<std::pair<int, int>>, double>
+reference_strings(fst_type const& f, ifst::semiring_type type, int limit, bool& overflow)
+{
+    using vertex = typename fst_type::vertex;
+
+    int eps = fst::symbol_trait<int>::eps;
+
+    std::unordered_set<vertex> final_set { f.finals().begin(), f.finals().end() };
+    std::map<std::vector<std::pair<int, int>>, double> scores;
+    std::vector<std::pair<int, int>> labels;
+    int paths = 0;
+
+    overflow = false;
+
+    std::function<void(vertex, double)> dfs = [&](vertex v, double score) {
+        if (overflow) {
+            return;
+        }
+
+        if (ebt::in(v, final_set)) {
+            auto iter = scores.find(labels);
+
+            if (iter == scores.end()) {
+                scores[labels] = score;
+            } else if (type == ifst::semiring_type::tropical) {
+                iter->second = std::max(iter->second, score);
+            } else {
+                iter->second = ebt::log_add(iter->second, score);
+            }
+
+            if (++paths > limit) {
+                overflow = true;
+                return;
+            }
+        }
+
+        for (auto& e: f.out_edges(v)) {
+            bool is_eps = f.input(e) == eps && f.output(e) == eps;
+
+            if (!is_eps) {
+                labels.push_back(std::make_pair(f.input(e), f.output(e)));
+            }
+
+            dfs(f.head(e), score + f.weight(e));
+
+            if (!is_eps) {
+                labels.pop_back();
+            }
+        }
+    };
+
+    for (auto& v: f.initials()) {
+        dfs(v, 0);
+    }
+
+    return scores;
+}
+
+struct checker {
+
+    std::ostringstream error;
+
+    bool ok() const
+    {
+        return error.str().size() == 0;
+    }
+
+    void close(std::string const& what, double expected, double actual, double tol)
+    {
+        if (!ok()) {
+            return;
+        }
+
+        double inf = std::numeric_limits<double>::infinity();
+
+        if (expected == -inf && actual == -inf) {
+            return;
+        }
+
+        if (!(std::fabs(expected - actual) <= tol * std::max(1.0, std::fabs(expected)))) {
+            error << what << ": expected " << expected << ", got " << actual;
+        }
+    }
+
+    void fail(std::string const& what)
+    {
+        if (ok()) {
+            error << what;
+        }
+    }
+
+};
+
+double const exact_tol = 1e-9;
+
+template <class fst_type>
+double best_final(fst_type const& f, std::unordered_map<typename fst_type::vertex, double> const& value)
+{
+    double max = -std::numeric_limits<double>::infinity();
+
+    for (auto& v: f.finals()) {
+        if (ebt::in(v, value)) {
+            max = std::max(max, value.at(v));
+        }
+    }
+
+    return max;
+}
+
+/*
+ * The score of `path`, or nan if it does not go from an initial to a
+ * final vertex.
+ *
+ */
+template <class fst_type>
+double path_score(fst_type const& f, std::vector<typename fst_type::edge> const& path)
+{
+    using vertex = typename fst_type::vertex;
+
+    std::unordered_set<vertex> initial_set { f.initials().begin(), f.initials().end() };
+    std::unordered_set<vertex> final_set { f.finals().begin(), f.finals().end() };
+
+    double nan = std::numeric_limits<double>::quiet_NaN();
+
+    if (path.size() == 0) {
+        for (auto& v: f.initials()) {
+            if (ebt::in(v, final_set)) {
+                return 0;
+            }
+        }
+
+        return -std::numeric_limits<double>::infinity();
+    }
+
+    if (!ebt::in(f.tail(path.front()), initial_set) || !ebt::in(f.head(path.back()), final_set)) {
+        return nan;
+    }
+
+    double score = 0;
+
+    for (int i = 0; i < path.size(); ++i) {
+        if (i > 0 && f.tail(path[i]) != f.head(path[i - 1])) {
+            return nan;
+        }
+
+        score += f.weight(path[i]);
+    }
+
+    return score;
+}
+
+template <class fst_type, class log_add_type>
+void check_log_sum(checker& c, std::string const& name, fst_type const& f,
+    std::vector<typename fst_type::vertex> const& order,
+    std::unordered_map<typename fst_type::vertex, double> const& expected, double tol)
+{
+    fst::forward_log_sum<fst_type, log_add_type> log_sum;
+    log_sum.merge(f, order);
+
+    for (auto& v: order) {
+        double actual = ebt::in(v, log_sum.extra) ? log_sum.extra.at(v)
+            : -std::numeric_limits<double>::infinity();
+        double e = ebt::in(v, expected) ? expected.at(v) : -std::numeric_limits<double>::infinity();
+
+        c.close(name, e, actual, tol);
+    }
+}
+
+/*
+ * Runs the engines that work on any fst on `f`, and compares them
+ * with the dynamic programs on `reference`, which should be the same
+ * graph.
+ *
+ */
+template <class fst_type, class reference_type>
+void check_engines(checker& c, std::string const& name, fst_type const& f,
+    std::vector<typename fst_type::vertex> const& order,
+    reference_type const& reference)
+{
+    using vertex = typename fst_type::vertex;
+    using edge = typename fst_type::edge;
+
+    double inf = std::numeric_limits<double>::infinity();
+
+    auto max = reference_max(reference, order);
+    auto log_sum = reference_log_sum(reference, order);
+    double best = best_final(reference, max);
+
+    {
+        fst::forward_one_best<fst_type> one_best;
+
+        for (auto& v: f.initials()) {
+            one_best.extra[v] = { fst::edge_trait<edge>::null, 0 };
+        }
+
+        one_best.merge(f, order);
+
+        for (auto& v: order) {
+            c.close(name + " forward_one_best value", ebt::in(v, max) ? max.at(v) : -inf,
+                ebt::in(v, one_best.extra) ? one_best.extra.at(v).value : -inf, exact_tol);
+        }
+
+        c.close(name + " forward_one_best path", best, path_score(f, one_best.best_path(f)), exact_tol);
+    }
+
+    {
+        fst::backward_one_best<fst_type> one_best;
+
+        for (auto& v: f.finals()) {
+            one_best.extra[v] = { fst::edge_trait<edge>::null, 0 };
+        }
+
+        one_best.merge(f, order);
+
+        double value = -inf;
+
+        for (auto& v: f.initials()) {
+            if (ebt::in(v, one_best.extra)) {
+                value = std::max(value, one_best.extra.at(v).value);
+            }
+        }
+
+        c.close(name + " backward_one_best value", best, value, exact_tol);
+        c.close(name + " backward_one_best path", best, path_score(f, one_best.best_path(f)), exact_tol);
+    }
+
+    check_log_sum<fst_type, fst::exact_log_add<>>(c, name + " forward_log_sum exact",
+        f, order, log_sum, exact_tol);
+
+    // Each approximate log add is within 1e-4, and errors add up along
+    // the order.
+    double approx_tol = 1e-4 * (order.size() + 1);
+
+    check_log_sum<fst_type, fst::table_log_add<>>(c, name + " forward_log_sum table",
+        f, order, log_sum, approx_tol);
+    check_log_sum<fst_type, fst::poly_log_add<>>(c, name + " forward_log_sum poly",
+        f, order, log_sum, approx_tol);
+
+    {
+        double total = -inf;
+
+        for (auto& v: f.finals()) {
+            if (ebt::in(v, log_sum)) {
+                total = ebt::log_add(total, log_sum.at(v));
+            }
+        }
+
+        fst::backward_log_sum<fst_type> backward;
+
+        std::vector<vertex> rev_order { order.rbegin(), order.rend() };
+        backward.merge(f, rev_order);
+
+        double value = -inf;
+
+        for (auto& v: f.initials()) {
+            if (ebt::in(v, backward.extra)) {
+                value = ebt::log_add(value, backward.extra.at(v));
+            }
+        }
+
+        c.close(name + " backward_log_sum", total, value, exact_tol);
+    }
+
+    {
+        fst::beam_search<fst_type> search;
+
+        for (auto& v: f.initials()) {
+            search.extra[v] = { fst::edge_trait<edge>::null, 0 };
+        }
+
+        // Beams only apply to vertices with at least `min_edges` in-edges.
+        search.merge(f, order, 0.5, INT_MAX);
+
+        c.close(name + " beam_search path", best, path_score(f, search.best_path(f)), exact_tol);
+    }
+
+    std::vector<std::pair<std::string, fst::queue_discipline>> disciplines {
+        { "fifo", fst::queue_discipline::fifo },
+        { "lifo", fst::queue_discipline::lifo },
+        { "priority", fst::queue_discipline::priority },
+        { "top_order", fst::queue_discipline::top_order }
+    };
+
+    for (auto& p: disciplines) {
+        fst::shortest_distance<fst_type> dist;
+        dist.merge(f, p.second);
+
+        for (auto& v: order) {
+            c.close(name + " shortest_distance " + p.first + " value", ebt::in(v, max) ? max.at(v) : -inf,
+                ebt::in(v, dist.extra) ? dist.extra.at(v).value : -inf, exact_tol);
+        }
+
+        c.close(name + " shortest_distance " + p.first + " path", best,
+            path_score(f, dist.best_path(f)), exact_tol);
+    }
+
+    {
+        fst::a_star<fst_type> search;
+        search.merge(f);
+
+        c.close(name + " a_star path", best, path_score(f, search.best_path(f)), exact_tol);
+    }
+}
+
+void check_fst(checker& c, ifst::fst const& f)
+{
+    std::vector<int> order;
+
+    for (int v = 0; v < f.vertices().size(); ++v) {
+        order.push_back(v);
+    }
+
+    check_engines(c, "fst", f, order, f);
+
+    double inf = std::numeric_limits<double>::infinity();
+    double best = best_final(f, reference_max(f, order));
+
+    {
+        fst::token_passing<ifst::fst> search;
+        search.merge(f, inf, 0);
+
+        c.close("fst token_passing path", best, path_score(f, search.best_path()), exact_tol);
+    }
+
+    {
+        static fst::work_stealing_pool pool { 2 };
+        std::vector<ifst::fst> fsts { f, f, f };
+
+        auto paths = fst::batch_shortest_path(pool, fsts);
+
+        for (auto& p: paths) {
+            c.close("fst batch_shortest_path", best, path_score(f, p), exact_tol);
+        }
+
+        double total = -inf;
+        auto log_sum = reference_log_sum(f, order);
+
+        for (auto& v: f.finals()) {
+            if (ebt::in(v, log_sum)) {
+                total = ebt::log_add(total, log_sum.at(v));
+            }
+        }
+
+        for (auto& s: fst::batch_forward_log_sum(pool, fsts)) {
+            c.close("fst batch_forward_log_sum", total, s, exact_tol);
+        }
+    }
+
+    // k-best is only defined for one final vertex.
+    if (f.finals().size() == 1) {
+        std::vector<double> scores = reference_paths(f, 1000);
+        int final = f.finals().front();
+
+        fst::forward_k_best<ifst::fst> k_best;
+        k_best.first_best(f, fst::topo_order(f));
+
+        for (int k = 0; k < std::min<int>(scores.size(), 5) && c.ok(); ++k) {
+            if (k > 0) {
+                k_best.next_best(f, final, k);
+            }
+
+            c.close("fst forward_k_best " + std::to_string(k), scores[k],
+                path_score(f, k_best.best_path(f, final, k)), exact_tol);
+        }
+    }
+}
+
+template <class edge>
+std::vector<edge> sorted(std::vector<edge> edges)
+{
+    std::sort(edges.begin(), edges.end());
+    return edges;
+}
+
+template <class symbol, class edge>
+std::map<symbol, std::vector<edge>> sorted(std::unordered_map<symbol, std::vector<edge>> const& map)
+{
+    std::map<symbol, std::vector<edge>> result;
+
+    for (auto& p: map) {
+        result[p.first] = sorted(p.second);
+    }
+
+    return result;
+}
+
+template <class fst_type>
+void check_same_edges(checker& c, std::string const& name,
+    fst::lazy_pair_fst<ifst::fst, ifst::fst> const& expected, fst_type const& f)
+{
+    if (sorted(expected.edges()) != sorted(f.edges())) {
+        c.fail(name + " edges");
+    }
+
+    for (auto& v: expected.vertices()) {
+        if (sorted(expected.in_edges(v)) != sorted(f.in_edges(v))) {
+            c.fail(name + " in_edges");
+        }
+
+        if (sorted(expected.out_edges(v)) != sorted(f.out_edges(v))) {
+            c.fail(name + " out_edges");
+        }
+
+        if (sorted(expected.in_edges_input_map(v)) != sorted(f.in_edges_input_map(v))) {
+            c.fail(name + " in_edges_input_map");
+        }
+
+        if (sorted(expected.in_edges_output_map(v)) != sorted(f.in_edges_output_map(v))) {
+            c.fail(name + " in_edges_output_map");
+        }
+
+        if (sorted(expected.out_edges_input_map(v)) != sorted(f.out_edges_input_map(v))) {
+            c.fail(name + " out_edges_input_map");
+        }
+
+        if (sorted(expected.out_edges_output_map(v)) != sorted(f.out_edges_output_map(v))) {
+            c.fail(name + " out_edges_output_map");
+        }
+    }
+}
+
+/*
+ * Keeps the even edges.  All references are taken before any list is
+ * compared, including for vertices past the mask, which must be empty.
+ *
+ */
+void check_subgraph(checker& c, ifst::fst const& f)
+{
+    std::vector<int> retained;
+
+    for (auto& e: f.edges()) {
+        if (e % 2 == 0) {
+            retained.push_back(e);
+        }
+    }
+
+    fst::subgraph_fst<ifst::fst> sub { f, retained };
+
+    int nvertices = f.vertices().size();
+
+    std::vector<std::vector<int> const*> in_lists;
+    std::vector<std::vector<int> const*> out_lists;
+
+    for (int v = 0; v < nvertices + 2; ++v) {
+        in_lists.push_back(&sub.in_edges(v));
+        out_lists.push_back(&sub.out_edges(v));
+    }
+
+    for (int v = 0; v < nvertices + 2; ++v) {
+        std::vector<int> in;
+        std::vector<int> out;
+
+        if (v < nvertices) {
+            for (auto& e: f.in_edges(v)) {
+                if (e % 2 == 0) {
+                    in.push_back(e);
+                }
+            }
+
+            for (auto& e: f.out_edges(v)) {
+                if (e % 2 == 0) {
+                    out.push_back(e);
+                }
+            }
+        }
+
+        if (*in_lists[v] != in) {
+            c.fail("subgraph_fst in_edges");
+        }
+
+        if (*out_lists[v] != out) {
+            c.fail("subgraph_fst out_edges");
+        }
+    }
+}
+
+/*
+ * Compares the label sequences of `f` and their scores with those of
+ * `expected`.  Scores of transformed graphs are only equal up to the
+ * rounding of residual weights, hence the loose tolerance.
+ *
+ */
+template <class fst_type>
+void check_same_strings(checker& c, std::string const& name,
+    std::map<std::vector<std::pair<int, int>>, double> const& expected,
+    fst_type const& f, ifst::semiring_type type)
+{
+    bool overflow;
+    auto actual = reference_strings(f, type, 1000, overflow);
+
+    if (overflow) {
+        return;
+    }
+
+    if (actual.size() != expected.size()) {
+        c.fail(name + " label sequences: expected " + std::to_string(expected.size())
+            + ", got " + std::to_string(actual.size()));
+        return;
+    }
+
+    for (auto& p: expected) {
+        auto iter = actual.find(p.first);
+
+        if (iter == actual.end()) {
+            c.fail(name + " label sequences");
+            return;
+        }
+
+        c.close(name + " label sequence score", p.second, iter->second, 1e-5);
+    }
+}
+
+template <class fst_type>
+void check_eps_free(checker& c, std::string const& name, fst_type const& f)
+{
+    int eps = fst::symbol_trait<int>::eps;
+
+    std::unordered_set<int> final_set { f.finals().begin(), f.finals().end() };
+
+    for (auto& e: f.edges()) {
+        if (f.input(e) == eps && f.output(e) == eps
+                && (!ebt::in(f.head(e), final_set) || f.out_edges(f.head(e)).size() > 0)) {
+            c.fail(name + " eps:eps edge not into the super-final vertex");
+        }
+    }
+}
+
+void check_transforms(checker& c, ifst::fst const& f)
+{
+    for (auto type: { ifst::semiring_type::tropical, ifst::semiring_type::log }) {
+        std::string suffix = (type == ifst::semiring_type::tropical ? " (tropical)" : " (log)");
+
+        bool overflow;
+        auto expected = reference_strings(f, type, 1000, overflow);
+
+        if (overflow) {
+            continue;
+        }
+
+        check_same_strings(c, "determinize" + suffix, expected,
+            ifst::determinize(f, type), type);
+        check_same_strings(c, "lazy_determinized_fst" + suffix, expected,
+            ifst::lazy_determinized_fst { f, type }, type);
+        check_same_strings(c, "push_weights" + suffix, expected,
+            ifst::push_weights(f, type), type);
+        check_same_strings(c, "minimize" + suffix, expected,
+            ifst::minimize(f, type), type);
+
+        ifst::fst no_eps = ifst::rm_eps(f, type);
+        ifst::lazy_rm_eps_fst lazy_no_eps { f, type };
+
+        check_same_strings(c, "rm_eps" + suffix, expected, no_eps, type);
+        check_same_strings(c, "lazy_rm_eps_fst" + suffix, expected, lazy_no_eps, type);
+        check_eps_free(c, "rm_eps" + suffix, no_eps);
+        check_eps_free(c, "lazy_rm_eps_fst" + suffix, lazy_no_eps);
+    }
+}
+
+void check_all(checker& c, ifst::fst const& f1, ifst::fst const& f2)
+{
+    check_fst(c, f1);
+    check_subgraph(c, f1);
+    check_transforms(c, f1);
+
+    // Tuples compare in lexicographic order, which is topological
+    // because both graphs are.
+    fst::lazy_pair_fst<ifst::fst, ifst::fst> pair { f1, f2 };
+    std::vector<std::tuple<int, int>> order = sorted(pair.vertices());
+
+    check_engines(c, "lazy_pair_fst", pair, order, pair);
+
+    {
+        fst::lazy_pair_mode1_fst<ifst::fst, ifst::fst> mode1 { f1, f2 };
+        check_same_edges(c, "lazy_pair_mode1_fst", pair, mode1);
+    }
+
+    {
+        fst::lazy_pair_mode2_fst<ifst::fst, ifst::fst> mode2 { f1, f2 };
+        check_same_edges(c, "lazy_pair_mode2_fst", pair, mode2);
+    }
+
+    {
+        fst::lazy_pair_mode1_fst<ifst::fst, ifst::fst> mode1 { f1, f2 };
+        fst::lazy_pair_fst<ifst::fst, ifst::fst> reference { f1, f2 };
+        check_engines(c, "lazy_pair_mode1_fst", mode1, order, reference);
+    }
+
+    {
+        fst::lazy_pair_mode2_fst<ifst::fst, ifst::fst> mode2 { f1, f2 };
+        fst::lazy_pair_fst<ifst::fst, ifst::fst> reference { f1, f2 };
+        check_engines(c, "lazy_pair_mode2_fst", mode2, order, reference);
+    }
+}
+
+std::string check(graph const& g1, graph const& g2)
+{
+    ifst::fst f1 = make_fst(g1);
+    ifst::fst f2 = make_fst(g2);
+
+    checker c;
+
+    try {
+        check_all(c, f1, f2);
+    } catch (std::exception const& e) {
+        c.fail(std::string("exception: ") + e.what());
+    }
+
+    return c.error.str();
+}
+
+graph remove_edge(graph const& g, int e)
+{
+    graph result = g;
+    result.edges.erase(result.edges.begin() + e);
+
+    return result;
+}
+
+graph remove_vertex(graph const& g, int v)
+{
+    graph result;
+    result.vertices = g.vertices - 1;
+
+    auto shift = [&](int u) { return u > v ? u - 1 : u; };
+
+    for (auto& e: g.edges) {
+        if (e.tail != v && e.head != v) {
+            ifst::edge_data d = e;
+            d.tail = shift(e.tail);
+            d.head = shift(e.head);
+            result.edges.push_back(d);
+        }
+    }
+
+    for (auto& u: g.initials) {
+        if (u != v) {
+            result.initials.push_back(shift(u));
+        }
+    }
+
+    for (auto& u: g.finals) {
+        if (u != v) {
+            result.finals.push_back(shift(u));
+        }
+    }
+
+    return result;
+}
+
+/*
+ * Greedily drops vertices and edges from either graph as long as the
+ * case still fails, until nothing more can be dropped.
+ *
+ */
+void shrink(graph& g1, graph& g2)
+{
+    bool changed = true;
+
+    auto try_case = [&](graph const& h1, graph const& h2) {
+        if (check(h1, h2).size() > 0) {
+            g1 = h1;
+            g2 = h2;
+            changed = true;
+            return true;
+        }
+
+        return false;
+    };
+
+    while (changed) {
+        changed = false;
+
+        for (int v = g1.vertices - 1; v >= 0 && g1.vertices > 1; --v) {
+            try_case(remove_vertex(g1, v), g2);
+        }
+
+        for (int v = g2.vertices - 1; v >= 0 && g2.vertices > 1; --v) {
+            try_case(g1, remove_vertex(g2, v));
+        }
+
+        for (int e = g1.edges.size() - 1; e >= 0; --e) {
+            try_case(remove_edge(g1, e), g2);
+        }
+
+        for (int e = g2.edges.size() - 1; e >= 0; --e) {
+            try_case(g1, remove_edge(g2, e));
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int cases = 1000;
+    int seed = 1;
+
+    if (argc > 1) {
+        cases = std::atoi(argv[1]);
+    }
+
+    if (argc > 2) {
+        seed = std::atoi(argv[2]);
+    }
+
+    std::mt19937 gen { (unsigned int) seed };
+
+    for (int i = 0; i < cases; ++i) {
+        graph g1 = random_graph(gen);
+        graph g2 = random_graph(gen);
+
+        std::string error = check(g1, g2);
+
+        if (error.size() == 0) {
+            continue;
+        }
+
+        std::cout << "case " << i << " failed: " << error << std::endl;
+
+        shrink(g1, g2);
+
+        std::cout << "shrunk to: " << check(g1, g2) << std::endl;
+        std::cout << std::endl << "fst1:" << std::endl;
+        print(std::cout, g1);
+        std::cout << std::endl << "fst2:" << std::endl;
+        print(std::cout, g2);
+
+        return 1;
+    }
+
+    std::cout << cases << " cases passed" << std::endl;
+
+    return 0;
+}
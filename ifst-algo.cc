@@ -0,0 +1,1268 @@
+#include "fst/ifst-algo.h"
+#include "fst/fst-algo.h"
+#include "ebt/ebt.h"
+#include <map>
+#include <array>
+#include <deque>
+#include <queue>
+#include <unordered_set>
+#include <functional>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace ifst {
+
+    namespace {
+
+        double plus(semiring_type type, double a, double b)
+        {
+            if (type == semiring_type::tropical) {
+                return std::max(a, b);
+            } else {
+                return ebt::log_add(a, b);
+            }
+        }
+
+        /*
+         * Whether the part `r` of the log sum `d` that has not been passed
+         * on yet changes `d` by more than `delta`, i.e., whether
+         * d - log(exp(d) - exp(r)) > delta.
+         *
+         */
+        bool significant(double d, double r, double delta)
+        {
+            return r >= d || -std::log1p(-std::exp(r - d)) > delta;
+        }
+
+        struct subset_hash {
+            size_t operator()(std::vector<std::pair<int, long>> const& key) const
+            {
+                size_t result = 0;
+
+                for (auto& p: key) {
+                    result = result * 31 + std::hash<int>()(p.first);
+                    result = result * 31 + std::hash<long>()(p.second);
+                }
+
+                return result;
+            }
+        };
+
+    }
+
+    /*
+     * The subsets found so far and the determinized fst built from them.
+     * The vertex id of a subset is its index in `subsets`.
+     *
+     */
+    struct determinize_state
+        : public lazy_expansion {
+
+        fst input;
+        semiring_type type;
+        double delta;
+        bool always_super_final;
+
+        std::vector<std::vector<std::pair<int, double>>> subsets;
+        std::vector<double> final_weights;
+        std::vector<bool> expanded;
+        std::unordered_map<std::vector<std::pair<int, long>>, int, subset_hash> subset_id;
+
+        int super_final;
+        long final_time;
+
+        determinize_state(fst const& f, semiring_type type, double delta,
+            bool always_super_final);
+
+        int add_subset(std::vector<std::pair<int, double>> subset);
+        int get_super_final();
+        void expand(int s) override;
+        void expand_all() override;
+    };
+
+    determinize_state::determinize_state(fst const& f, semiring_type type, double delta,
+            bool always_super_final)
+        : input(f), type(type), delta(delta), always_super_final(always_super_final)
+        , super_final(-1), final_time(0)
+    {
+        result.data = std::make_shared<fst_data>();
+        result.data->name = f.data->name;
+        result.data->symbol_id = f.data->symbol_id;
+        result.data->id_symbol = f.data->id_symbol;
+
+        for (auto& v: f.finals()) {
+            final_time = std::max(final_time, f.time(v));
+        }
+
+        if (always_super_final) {
+            get_super_final();
+        }
+
+        std::vector<std::pair<int, double>> start;
+
+        for (auto& v: f.initials()) {
+            start.push_back(std::make_pair(v, 0.0));
+        }
+
+        if (start.size() > 0) {
+            result.data->initials.push_back(add_subset(start));
+        }
+    }
+
+    int determinize_state::add_subset(std::vector<std::pair<int, double>> subset)
+    {
+        std::sort(subset.begin(), subset.end(),
+            [](std::pair<int, double> const& p1, std::pair<int, double> const& p2) {
+                return p1.first < p2.first;
+            });
+
+        int size = 0;
+
+        for (int i = 0; i < subset.size(); ++i) {
+            if (size > 0 && subset[size - 1].first == subset[i].first) {
+                subset[size - 1].second = plus(type, subset[size - 1].second, subset[i].second);
+            } else {
+                subset[size] = subset[i];
+                ++size;
+            }
+        }
+
+        subset.resize(size);
+
+        std::vector<std::pair<int, long>> key;
+
+        for (auto& p: subset) {
+            key.push_back(std::make_pair(p.first, std::lround(p.second / delta)));
+        }
+
+        auto iter = subset_id.find(key);
+
+        if (iter != subset_id.end()) {
+            return iter->second;
+        }
+
+        double inf = std::numeric_limits<double>::infinity();
+
+        long time = std::numeric_limits<long>::max();
+        double final_weight = -inf;
+
+        for (auto& p: subset) {
+            time = std::min(time, input.time(p.first));
+        }
+
+        for (auto& v: input.finals()) {
+            auto p_iter = std::lower_bound(subset.begin(), subset.end(), std::make_pair(v, -inf));
+
+            if (p_iter != subset.end() && p_iter->first == v) {
+                final_weight = plus(type, final_weight, p_iter->second);
+            }
+        }
+
+        int s = subsets.size();
+
+        subset_id[key] = s;
+        subsets.push_back(std::move(subset));
+        final_weights.push_back(final_weight);
+        expanded.push_back(false);
+
+        add_vertex(*result.data, s, vertex_data { time });
+
+        if (final_weight != -inf && !always_super_final && std::fabs(final_weight) <= delta) {
+            result.data->finals.push_back(s);
+        }
+
+        return s;
+    }
+
+    int determinize_state::get_super_final()
+    {
+        if (super_final == -1) {
+            super_final = subsets.size();
+
+            subsets.push_back({});
+            final_weights.push_back(-std::numeric_limits<double>::infinity());
+            expanded.push_back(true);
+
+            add_vertex(*result.data, super_final, vertex_data { final_time });
+            result.data->finals.push_back(super_final);
+        }
+
+        return super_final;
+    }
+
+    void determinize_state::expand(int s)
+    {
+        if (expanded[s]) {
+            return;
+        }
+
+        expanded[s] = true;
+
+        std::vector<std::pair<int, double>> subset = subsets[s];
+
+        std::map<std::pair<int, int>, std::vector<std::pair<int, double>>> label_heads;
+
+        for (auto& p: subset) {
+            for (auto& e: input.out_edges(p.first)) {
+                label_heads[std::make_pair(input.input(e), input.output(e))].push_back(
+                    std::make_pair(input.head(e), p.second + input.weight(e)));
+            }
+        }
+
+        for (auto& q: label_heads) {
+            double w = -std::numeric_limits<double>::infinity();
+
+            for (auto& p: q.second) {
+                w = plus(type, w, p.second);
+            }
+
+            for (auto& p: q.second) {
+                p.second -= w;
+            }
+
+            int t = add_subset(std::move(q.second));
+
+            add_edge(*result.data, result.data->edges.size(),
+                edge_data { s, t, w, q.first.first, q.first.second });
+        }
+
+        double final_weight = final_weights[s];
+
+        if (final_weight != -std::numeric_limits<double>::infinity()
+                && (always_super_final || std::fabs(final_weight) > delta)) {
+            int eps = ::fst::symbol_trait<int>::eps;
+
+            add_edge(*result.data, result.data->edges.size(),
+                edge_data { s, get_super_final(), final_weight, eps, eps });
+        }
+    }
+
+    void determinize_state::expand_all()
+    {
+        for (int s = 0; s < subsets.size(); ++s) {
+            expand(s);
+        }
+    }
+
+    fst determinize(fst const& f, semiring_type type, double delta)
+    {
+        determinize_state state { f, type, delta, false };
+        state.expand_all();
+
+        return state.result;
+    }
+
+    lazy_expansion::~lazy_expansion()
+    {}
+
+    std::vector<int> const& lazy_expanded_fst::vertices() const
+    {
+        state->expand_all();
+        return state->result.vertices();
+    }
+
+    std::vector<int> const& lazy_expanded_fst::edges() const
+    {
+        state->expand_all();
+        return state->result.edges();
+    }
+
+    double lazy_expanded_fst::weight(int e) const
+    {
+        return state->result.weight(e);
+    }
+
+    std::vector<int> const& lazy_expanded_fst::in_edges(int v) const
+    {
+        state->expand_all();
+        return state->result.in_edges(v);
+    }
+
+    std::vector<int> const& lazy_expanded_fst::out_edges(int v) const
+    {
+        state->expand(v);
+        return state->result.out_edges(v);
+    }
+
+    int lazy_expanded_fst::tail(int e) const
+    {
+        return state->result.tail(e);
+    }
+
+    int lazy_expanded_fst::head(int e) const
+    {
+        return state->result.head(e);
+    }
+
+    std::vector<int> const& lazy_expanded_fst::initials() const
+    {
+        return state->result.initials();
+    }
+
+    std::vector<int> const& lazy_expanded_fst::finals() const
+    {
+        return state->result.finals();
+    }
+
+    int const& lazy_expanded_fst::input(int e) const
+    {
+        return state->result.input(e);
+    }
+
+    int const& lazy_expanded_fst::output(int e) const
+    {
+        return state->result.output(e);
+    }
+
+    long lazy_expanded_fst::time(int v) const
+    {
+        return state->result.time(v);
+    }
+
+    std::unordered_map<int, std::vector<int>> const&
+    lazy_expanded_fst::in_edges_input_map(int v) const
+    {
+        state->expand_all();
+        return state->result.in_edges_input_map(v);
+    }
+
+    std::unordered_map<int, std::vector<int>> const&
+    lazy_expanded_fst::in_edges_output_map(int v) const
+    {
+        state->expand_all();
+        return state->result.in_edges_output_map(v);
+    }
+
+    std::unordered_map<int, std::vector<int>> const&
+    lazy_expanded_fst::out_edges_input_map(int v) const
+    {
+        state->expand(v);
+        return state->result.out_edges_input_map(v);
+    }
+
+    std::unordered_map<int, std::vector<int>> const&
+    lazy_expanded_fst::out_edges_output_map(int v) const
+    {
+        state->expand(v);
+        return state->result.out_edges_output_map(v);
+    }
+
+    lazy_determinized_fst::lazy_determinized_fst(fst f, semiring_type type, double delta)
+    {
+        state = std::make_shared<determinize_state>(f, type, delta, true);
+    }
+
+    fst remap(fst const& f, std::vector<int> const& vertices, std::vector<int> const& edges,
+        std::vector<int>& vertex_map, std::vector<int>& edge_map)
+    {
+        fst_data const& data = *f.data;
+
+        vertex_map.assign(data.vertices.size(), -1);
+        edge_map.assign(data.edges.size(), -1);
+
+        fst result;
+        result.data = std::make_shared<fst_data>();
+
+        fst_data& new_data = *result.data;
+
+        new_data.name = data.name;
+        new_data.symbol_id = data.symbol_id;
+        new_data.id_symbol = data.id_symbol;
+
+        new_data.vertex_indices.reserve(vertices.size());
+        new_data.vertex_set.reserve(vertices.size());
+        new_data.edge_indices.reserve(edges.size());
+        new_data.edge_set.reserve(edges.size());
+
+        for (int i = 0; i < vertices.size(); ++i) {
+            int v = vertices[i];
+            vertex_map[v] = i;
+            add_vertex(new_data, i, data.vertices[v]);
+            new_data.vertex_attrs[i] = data.vertex_attrs[v];
+        }
+
+        for (int i = 0; i < edges.size(); ++i) {
+            int e = edges[i];
+            edge_map[e] = i;
+
+            edge_data e_data = data.edges[e];
+            e_data.tail = vertex_map[e_data.tail];
+            e_data.head = vertex_map[e_data.head];
+
+            add_edge(new_data, i, e_data);
+            new_data.edge_attrs[i] = data.edge_attrs[e];
+            new_data.feats[i] = data.feats[e];
+        }
+
+        for (auto& v: data.initials) {
+            if (vertex_map[v] != -1) {
+                new_data.initials.push_back(vertex_map[v]);
+            }
+        }
+
+        for (auto& v: data.finals) {
+            if (vertex_map[v] != -1) {
+                new_data.finals.push_back(vertex_map[v]);
+            }
+        }
+
+        return result;
+    }
+
+    fst connect(fst const& f, std::vector<int>& vertex_map, std::vector<int>& edge_map)
+    {
+        fst_data const& data = *f.data;
+
+        auto traverse = [&](std::vector<int> const& starts,
+                std::vector<std::vector<int>> const& adj, bool forward) {
+            std::vector<bool> visited;
+            visited.resize(data.vertices.size());
+
+            std::vector<int> stack = starts;
+
+            for (auto& v: starts) {
+                visited[v] = true;
+            }
+
+            while (stack.size() > 0) {
+                int v = stack.back();
+                stack.pop_back();
+
+                for (auto& e: adj[v]) {
+                    int u = (forward ? data.edges[e].head : data.edges[e].tail);
+
+                    if (!visited[u]) {
+                        visited[u] = true;
+                        stack.push_back(u);
+                    }
+                }
+            }
+
+            return visited;
+        };
+
+        std::vector<bool> accessible = traverse(data.initials, data.out_edges, true);
+        std::vector<bool> coaccessible = traverse(data.finals, data.in_edges, false);
+
+        std::vector<int> vertices;
+
+        for (auto& v: data.vertex_indices) {
+            if (accessible[v] && coaccessible[v]) {
+                vertices.push_back(v);
+            }
+        }
+
+        std::vector<int> edges;
+
+        for (auto& e: data.edge_indices) {
+            int tail = data.edges[e].tail;
+            int head = data.edges[e].head;
+
+            if (accessible[tail] && coaccessible[tail] && accessible[head] && coaccessible[head]) {
+                edges.push_back(e);
+            }
+        }
+
+        return remap(f, vertices, edges, vertex_map, edge_map);
+    }
+
+    fst connect(fst const& f)
+    {
+        std::vector<int> vertex_map;
+        std::vector<int> edge_map;
+
+        return connect(f, vertex_map, edge_map);
+    }
+
+    fst renumber(fst const& f, vertex_order v_order, edge_order e_order,
+        std::vector<int>& vertex_map, std::vector<int>& edge_map)
+    {
+        fst_data const& data = *f.data;
+
+        std::vector<int> vertices = ::fst::topo_order(f);
+
+        std::vector<int> rank;
+        rank.resize(data.vertices.size(), -1);
+
+        for (int i = 0; i < vertices.size(); ++i) {
+            rank[vertices[i]] = i;
+        }
+
+        std::vector<int> rest;
+
+        for (auto& v: data.vertex_indices) {
+            if (rank[v] == -1) {
+                rest.push_back(v);
+            }
+        }
+
+        std::sort(rest.begin(), rest.end());
+
+        for (auto& v: rest) {
+            rank[v] = vertices.size();
+            vertices.push_back(v);
+        }
+
+        if (v_order == vertex_order::time) {
+            std::stable_sort(vertices.begin(), vertices.end(),
+                [&](int u, int v) {
+                    return data.vertices[u].time < data.vertices[v].time;
+                });
+
+            for (int i = 0; i < vertices.size(); ++i) {
+                rank[vertices[i]] = i;
+            }
+        }
+
+        std::vector<int> edges;
+        edges.reserve(data.edge_indices.size());
+
+        for (auto& v: vertices) {
+            int begin = edges.size();
+
+            if (e_order == edge_order::by_tail) {
+                for (auto& e: data.out_edges[v]) {
+                    edges.push_back(e);
+                }
+
+                std::stable_sort(edges.begin() + begin, edges.end(),
+                    [&](int e1, int e2) {
+                        return rank[data.edges[e1].head] < rank[data.edges[e2].head];
+                    });
+            } else {
+                for (auto& e: data.in_edges[v]) {
+                    edges.push_back(e);
+                }
+
+                std::stable_sort(edges.begin() + begin, edges.end(),
+                    [&](int e1, int e2) {
+                        return rank[data.edges[e1].tail] < rank[data.edges[e2].tail];
+                    });
+            }
+        }
+
+        return remap(f, vertices, edges, vertex_map, edge_map);
+    }
+
+    fst renumber(fst const& f, vertex_order v_order, edge_order e_order)
+    {
+        std::vector<int> vertex_map;
+        std::vector<int> edge_map;
+
+        return renumber(f, v_order, e_order, vertex_map, edge_map);
+    }
+
+    namespace {
+
+        std::vector<double> distance(fst const& f, semiring_type type, double delta,
+            std::vector<int> const& starts, bool forward)
+        {
+            fst_data const& data = *f.data;
+
+            auto const& adj = (forward ? data.out_edges : data.in_edges);
+
+            auto other = [&](int e) {
+                return forward ? data.edges[e].head : data.edges[e].tail;
+            };
+
+            // Vertices are relaxed in a topological order from the starts,
+            // so on acyclic graphs each one is relaxed once.  On cyclic
+            // graphs the order is a DFS finishing order and a vertex is
+            // relaxed again when new weight arrives.
+
+            std::vector<int> rank;
+            rank.resize(data.vertices.size(), -1);
+
+            {
+                std::vector<int> finished;
+                std::vector<bool> visited;
+                visited.resize(data.vertices.size());
+
+                std::vector<std::pair<int, int>> stack;
+
+                for (auto& s: starts) {
+                    if (visited[s]) {
+                        continue;
+                    }
+
+                    visited[s] = true;
+                    stack.push_back(std::make_pair(s, 0));
+
+                    while (stack.size() > 0) {
+                        int v = stack.back().first;
+                        int i = stack.back().second;
+
+                        if (i < adj[v].size()) {
+                            ++stack.back().second;
+                            int u = other(adj[v][i]);
+
+                            if (!visited[u]) {
+                                visited[u] = true;
+                                stack.push_back(std::make_pair(u, 0));
+                            }
+                        } else {
+                            finished.push_back(v);
+                            stack.pop_back();
+                        }
+                    }
+                }
+
+                for (int i = 0; i < finished.size(); ++i) {
+                    rank[finished[i]] = finished.size() - 1 - i;
+                }
+            }
+
+            double inf = std::numeric_limits<double>::infinity();
+
+            std::vector<double> d;
+            d.resize(data.vertices.size(), -inf);
+
+            std::vector<double> r;
+            r.resize(data.vertices.size(), -inf);
+
+            std::vector<bool> queued;
+            queued.resize(data.vertices.size());
+
+            using rank_vertex = std::pair<int, int>;
+            std::priority_queue<rank_vertex, std::vector<rank_vertex>,
+                std::greater<rank_vertex>> queue;
+
+            for (auto& s: starts) {
+                d[s] = 0;
+                r[s] = 0;
+
+                if (!queued[s]) {
+                    queued[s] = true;
+                    queue.push(std::make_pair(rank[s], s));
+                }
+            }
+
+            while (queue.size() > 0) {
+                int v = queue.top().second;
+                queue.pop();
+                queued[v] = false;
+
+                double r_v = r[v];
+                r[v] = -inf;
+
+                for (auto& e: adj[v]) {
+                    int u = other(e);
+                    double candidate = r_v + data.edges[e].weight;
+                    double d_u = plus(type, d[u], candidate);
+
+                    if (type == semiring_type::tropical && !(d_u > d[u])) {
+                        continue;
+                    }
+
+                    d[u] = d_u;
+                    r[u] = plus(type, r[u], candidate);
+
+                    // In the log semiring every contribution is added,
+                    // but `u` is only relaxed again once what it holds
+                    // back is more than `delta` of its value.
+                    bool changed = (type == semiring_type::tropical
+                        || significant(d[u], r[u], delta));
+
+                    if (changed && !queued[u]) {
+                        queued[u] = true;
+                        queue.push(std::make_pair(rank[u], u));
+                    }
+                }
+            }
+
+            return d;
+        }
+
+    }
+
+    std::vector<double> forward_distance(fst const& f, semiring_type type, double delta)
+    {
+        return distance(f, type, delta, f.data->initials, true);
+    }
+
+    std::vector<double> backward_distance(fst const& f, semiring_type type, double delta)
+    {
+        return distance(f, type, delta, f.data->finals, false);
+    }
+
+    fst push_weights(fst const& f, semiring_type type, bool remove_total, double delta)
+    {
+        fst result;
+        result.data = std::make_shared<fst_data>(*f.data);
+
+        fst_data& data = *result.data;
+
+        int eps = ::fst::symbol_trait<int>::eps;
+        double inf = std::numeric_limits<double>::infinity();
+
+        std::vector<double> d = backward_distance(result, type, delta);
+
+        // A final vertex with paths leaving it would need a final
+        // weight of -d[v] after pushing.  Put that on an edge instead.
+
+        std::vector<int> finals;
+        int super_final = -1;
+
+        for (auto& v: data.finals) {
+            if (std::fabs(d[v]) <= delta) {
+                finals.push_back(v);
+                continue;
+            }
+
+            if (super_final == -1) {
+                super_final = data.vertices.size();
+                add_vertex(data, super_final, data.vertices[v]);
+                finals.push_back(super_final);
+            }
+
+            data.vertices[super_final].time = std::max(data.vertices[super_final].time,
+                data.vertices[v].time);
+            add_edge(data, data.edges.size(), edge_data { v, super_final, 0, eps, eps });
+        }
+
+        data.finals = finals;
+
+        if (super_final != -1) {
+            d = backward_distance(result, type, delta);
+        }
+
+        for (auto& e: data.edge_indices) {
+            edge_data& e_data = data.edges[e];
+
+            if (d[e_data.tail] != -inf && d[e_data.head] != -inf) {
+                e_data.weight += d[e_data.head] - d[e_data.tail];
+            }
+        }
+
+        if (!remove_total) {
+            std::vector<int> initials;
+
+            for (auto& v: data.initials) {
+                if (d[v] == -inf || std::fabs(d[v]) <= delta) {
+                    initials.push_back(v);
+                } else if (data.in_edges[v].size() == 0
+                        && std::find(data.finals.begin(), data.finals.end(), v) == data.finals.end()) {
+                    initials.push_back(v);
+
+                    for (auto& e: data.out_edges[v]) {
+                        data.edges[e].weight += d[v];
+                    }
+                } else {
+                    int u = data.vertices.size();
+                    add_vertex(data, u, data.vertices[v]);
+                    add_edge(data, data.edges.size(), edge_data { u, v, d[v], eps, eps });
+                    initials.push_back(u);
+                }
+            }
+
+            data.initials = initials;
+        }
+
+        return result;
+    }
+
+    fst minimize(fst const& f, semiring_type type, double delta)
+    {
+        fst g = connect(push_weights(f, type, false, delta));
+        fst_data const& data = *g.data;
+
+        int nvertices = data.vertices.size();
+
+        std::vector<bool> is_final;
+        is_final.resize(nvertices);
+
+        for (auto& v: data.finals) {
+            is_final[v] = true;
+        }
+
+        // A signature is (finality, time, then (input, output, weight,
+        // class of head) for each out-edge, sorted).  Two vertices with
+        // the same signature have the same future.
+
+        std::vector<int> cls;
+        cls.resize(nvertices, 0);
+
+        auto signature = [&](int v) {
+            std::vector<std::array<long, 4>> tuples;
+
+            for (auto& e: data.out_edges[v]) {
+                edge_data const& e_data = data.edges[e];
+                tuples.push_back({{ e_data.input, e_data.output,
+                    std::lround(e_data.weight / delta), cls[e_data.head] }});
+            }
+
+            std::sort(tuples.begin(), tuples.end());
+
+            std::vector<long> result { long(is_final[v]), data.vertices[v].time };
+
+            for (auto& t: tuples) {
+                result.insert(result.end(), t.begin(), t.end());
+            }
+
+            return result;
+        };
+
+        std::vector<int> order = ::fst::topo_order(g);
+
+        std::vector<int> rank;
+        rank.resize(nvertices);
+
+        for (int i = 0; i < order.size(); ++i) {
+            rank[order[i]] = i;
+        }
+
+        bool acyclic = true;
+
+        for (auto& e: data.edge_indices) {
+            if (rank[data.edges[e].tail] >= rank[data.edges[e].head]) {
+                acyclic = false;
+                break;
+            }
+        }
+
+        int nclasses = 0;
+
+        if (acyclic) {
+            // Heads are classified before tails, so one pass suffices.
+
+            std::map<std::vector<long>, int> class_id;
+
+            for (int i = order.size() - 1; i >= 0; --i) {
+                int v = order[i];
+                std::vector<long> sig = signature(v);
+                auto iter = class_id.find(sig);
+
+                if (iter == class_id.end()) {
+                    cls[v] = nclasses;
+                    class_id[sig] = nclasses;
+                    ++nclasses;
+                } else {
+                    cls[v] = iter->second;
+                }
+            }
+        } else {
+            // Refine until the number of classes stops growing.  Each
+            // round splits classes only, since the old class is part of
+            // the signature.
+
+            nclasses = 1;
+
+            while (1) {
+                std::map<std::vector<long>, int> class_id;
+                std::vector<int> new_cls;
+                new_cls.resize(nvertices);
+
+                for (auto& v: data.vertex_indices) {
+                    std::vector<long> sig = signature(v);
+                    sig.push_back(cls[v]);
+
+                    auto iter = class_id.find(sig);
+
+                    if (iter == class_id.end()) {
+                        int c = class_id.size();
+                        class_id[sig] = c;
+                        new_cls[v] = c;
+                    } else {
+                        new_cls[v] = iter->second;
+                    }
+                }
+
+                cls = new_cls;
+
+                if (class_id.size() == nclasses) {
+                    break;
+                }
+
+                nclasses = class_id.size();
+            }
+        }
+
+        // Build the quotient from one representative per class.
+
+        std::vector<int> rep;
+        rep.resize(nclasses, -1);
+
+        for (auto& v: data.vertex_indices) {
+            if (rep[cls[v]] == -1) {
+                rep[cls[v]] = v;
+            }
+        }
+
+        fst result;
+        result.data = std::make_shared<fst_data>();
+
+        fst_data& new_data = *result.data;
+
+        new_data.name = data.name;
+        new_data.symbol_id = data.symbol_id;
+        new_data.id_symbol = data.id_symbol;
+
+        for (int c = 0; c < nclasses; ++c) {
+            add_vertex(new_data, c, data.vertices[rep[c]]);
+            new_data.vertex_attrs[c] = data.vertex_attrs[rep[c]];
+        }
+
+        for (int c = 0; c < nclasses; ++c) {
+            for (auto& e: data.out_edges[rep[c]]) {
+                edge_data e_data = data.edges[e];
+                e_data.tail = c;
+                e_data.head = cls[e_data.head];
+
+                int new_e = new_data.edges.size();
+                add_edge(new_data, new_e, e_data);
+                new_data.edge_attrs[new_e] = data.edge_attrs[e];
+                new_data.feats[new_e] = data.feats[e];
+            }
+        }
+
+        for (auto& v: data.initials) {
+            if (std::find(new_data.initials.begin(), new_data.initials.end(), cls[v])
+                    == new_data.initials.end()) {
+                new_data.initials.push_back(cls[v]);
+            }
+        }
+
+        for (auto& v: data.finals) {
+            if (std::find(new_data.finals.begin(), new_data.finals.end(), cls[v])
+                    == new_data.finals.end()) {
+                new_data.finals.push_back(cls[v]);
+            }
+        }
+
+        return result;
+    }
+
+    fst posterior_prune(fst const& f, double beam, semiring_type type,
+        std::vector<int>& vertex_map, std::vector<int>& edge_map)
+    {
+        fst_data const& data = *f.data;
+
+        double inf = std::numeric_limits<double>::infinity();
+
+        std::vector<double> fwd = forward_distance(f, type);
+        std::vector<double> bwd = backward_distance(f, type);
+
+        double best = -inf;
+
+        for (auto& v: data.finals) {
+            best = plus(type, best, fwd[v]);
+        }
+
+        std::vector<int> edges;
+
+        if (best != -inf) {
+            for (auto& e: data.edge_indices) {
+                edge_data const& e_data = data.edges[e];
+                double through = fwd[e_data.tail] + e_data.weight + bwd[e_data.head];
+
+                if (through != -inf && through >= best - beam) {
+                    edges.push_back(e);
+                }
+            }
+        }
+
+        // In the log semiring the edges next to a kept edge can fall
+        // below the beam, so what is left is trimmed with `connect`.
+
+        std::vector<int> kept_vertex_map;
+        std::vector<int> kept_edge_map;
+
+        fst kept = remap(f, data.vertex_indices, edges, kept_vertex_map, kept_edge_map);
+
+        std::vector<int> connect_vertex_map;
+        std::vector<int> connect_edge_map;
+
+        fst result = connect(kept, connect_vertex_map, connect_edge_map);
+
+        vertex_map.assign(data.vertices.size(), -1);
+        edge_map.assign(data.edges.size(), -1);
+
+        for (auto& v: data.vertex_indices) {
+            if (kept_vertex_map[v] != -1) {
+                vertex_map[v] = connect_vertex_map[kept_vertex_map[v]];
+            }
+        }
+
+        for (auto& e: edges) {
+            edge_map[e] = connect_edge_map[kept_edge_map[e]];
+        }
+
+        return result;
+    }
+
+    fst posterior_prune(fst const& f, double beam, semiring_type type)
+    {
+        std::vector<int> vertex_map;
+        std::vector<int> edge_map;
+
+        return posterior_prune(f, beam, type, vertex_map, edge_map);
+    }
+
+    /*
+     * The vertices of the input reached so far and the epsilon-free
+     * fst built from them.  `closures[s]` is kept until `s` is expanded.
+     *
+     */
+    struct rm_eps_state
+        : public lazy_expansion {
+
+        fst input;
+        semiring_type type;
+        double delta;
+
+        std::vector<int> vertex_id;
+        std::vector<int> input_vertex;
+        std::vector<std::vector<std::pair<int, double>>> closures;
+        std::vector<double> final_weights;
+        std::vector<bool> expanded;
+
+        int super_final;
+        long final_time;
+
+        rm_eps_state(fst const& f, semiring_type type, double delta);
+
+        bool is_eps(int e) const;
+        std::vector<std::pair<int, double>> closure(int v) const;
+        int get_vertex(int v);
+        int get_super_final();
+        void expand(int s) override;
+        void expand_all() override;
+    };
+
+    rm_eps_state::rm_eps_state(fst const& f, semiring_type type, double delta)
+        : input(f), type(type), delta(delta), super_final(-1), final_time(0)
+    {
+        result.data = std::make_shared<fst_data>();
+        result.data->name = f.data->name;
+        result.data->symbol_id = f.data->symbol_id;
+        result.data->id_symbol = f.data->id_symbol;
+
+        vertex_id.resize(f.data->vertices.size(), -1);
+
+        for (auto& v: f.finals()) {
+            final_time = std::max(final_time, f.time(v));
+        }
+
+        for (auto& v: f.initials()) {
+            result.data->initials.push_back(get_vertex(v));
+        }
+
+        // The vertices whose closure contains a final vertex are the ones
+        // reaching it backward through epsilon edges.  Creating them now
+        // makes `finals` complete before anything is expanded.
+
+        std::vector<bool> reaches_final;
+        reaches_final.resize(f.data->vertices.size());
+
+        std::vector<int> stack;
+
+        for (auto& v: f.finals()) {
+            if (!reaches_final[v]) {
+                reaches_final[v] = true;
+                stack.push_back(v);
+            }
+        }
+
+        while (stack.size() > 0) {
+            int v = stack.back();
+            stack.pop_back();
+
+            get_vertex(v);
+
+            for (auto& e: f.in_edges(v)) {
+                int u = f.tail(e);
+
+                if (is_eps(e) && !reaches_final[u]) {
+                    reaches_final[u] = true;
+                    stack.push_back(u);
+                }
+            }
+        }
+    }
+
+    bool rm_eps_state::is_eps(int e) const
+    {
+        int eps = ::fst::symbol_trait<int>::eps;
+
+        return input.input(e) == eps && input.output(e) == eps;
+    }
+
+    std::vector<std::pair<int, double>> rm_eps_state::closure(int v) const
+    {
+        double inf = std::numeric_limits<double>::infinity();
+
+        std::unordered_map<int, double> d;
+        std::unordered_map<int, double> r;
+
+        std::deque<int> queue;
+        std::unordered_set<int> queued;
+
+        d[v] = 0;
+        r[v] = 0;
+        queue.push_back(v);
+        queued.insert(v);
+
+        while (queue.size() > 0) {
+            int u = queue.front();
+            queue.pop_front();
+            queued.erase(u);
+
+            double r_u = r.at(u);
+            r[u] = -inf;
+
+            for (auto& e: input.out_edges(u)) {
+                int t = input.head(e);
+
+                if (!is_eps(e) || (t == u && type == semiring_type::tropical)) {
+                    continue;
+                }
+
+                double candidate = r_u + input.weight(e);
+                double d_t = (ebt::in(t, d) ? d.at(t) : -inf);
+                double new_d = plus(type, d_t, candidate);
+
+                if (type == semiring_type::tropical && !(new_d > d_t)) {
+                    continue;
+                }
+
+                double r_t = plus(type, (ebt::in(t, r) ? r.at(t) : -inf), candidate);
+
+                d[t] = new_d;
+                r[t] = r_t;
+
+                // As in `distance`, small contributions are added but
+                // only passed on once they add up.
+                bool changed = (type == semiring_type::tropical
+                    || significant(new_d, r_t, delta));
+
+                if (changed && !ebt::in(t, queued)) {
+                    queue.push_back(t);
+                    queued.insert(t);
+                }
+            }
+        }
+
+        std::vector<std::pair<int, double>> result { d.begin(), d.end() };
+        std::sort(result.begin(), result.end());
+
+        return result;
+    }
+
+    int rm_eps_state::get_vertex(int v)
+    {
+        if (vertex_id[v] != -1) {
+            return vertex_id[v];
+        }
+
+        double final_weight = -std::numeric_limits<double>::infinity();
+
+        std::vector<std::pair<int, double>> c = closure(v);
+
+        for (auto& u: input.finals()) {
+            auto p_iter = std::lower_bound(c.begin(), c.end(),
+                std::make_pair(u, -std::numeric_limits<double>::infinity()));
+
+            if (p_iter != c.end() && p_iter->first == u) {
+                final_weight = plus(type, final_weight, p_iter->second);
+            }
+        }
+
+        int s = input_vertex.size();
+
+        vertex_id[v] = s;
+        input_vertex.push_back(v);
+        closures.push_back(std::move(c));
+        final_weights.push_back(final_weight);
+        expanded.push_back(false);
+
+        add_vertex(*result.data, s, input.data->vertices[v]);
+        result.data->vertex_attrs[s] = input.data->vertex_attrs[v];
+
+        if (final_weight != -std::numeric_limits<double>::infinity()) {
+            if (std::fabs(final_weight) <= delta) {
+                result.data->finals.push_back(s);
+            } else {
+                get_super_final();
+            }
+        }
+
+        return s;
+    }
+
+    int rm_eps_state::get_super_final()
+    {
+        if (super_final == -1) {
+            super_final = input_vertex.size();
+
+            input_vertex.push_back(-1);
+            closures.push_back({});
+            final_weights.push_back(-std::numeric_limits<double>::infinity());
+            expanded.push_back(true);
+
+            add_vertex(*result.data, super_final, vertex_data { final_time });
+            result.data->finals.push_back(super_final);
+        }
+
+        return super_final;
+    }
+
+    void rm_eps_state::expand(int s)
+    {
+        if (expanded[s]) {
+            return;
+        }
+
+        expanded[s] = true;
+
+        std::vector<std::pair<int, double>> c;
+        c.swap(closures[s]);
+
+        for (auto& p: c) {
+            for (auto& e: input.out_edges(p.first)) {
+                if (is_eps(e)) {
+                    continue;
+                }
+
+                int t = get_vertex(input.head(e));
+                int new_e = result.data->edges.size();
+
+                add_edge(*result.data, new_e, edge_data { s, t, p.second + input.weight(e),
+                    input.input(e), input.output(e) });
+                result.data->edge_attrs[new_e] = input.data->edge_attrs[e];
+                result.data->feats[new_e] = input.data->feats[e];
+            }
+        }
+
+        double final_weight = final_weights[s];
+
+        if (final_weight != -std::numeric_limits<double>::infinity()
+                && std::fabs(final_weight) > delta) {
+            int eps = ::fst::symbol_trait<int>::eps;
+
+            add_edge(*result.data, result.data->edges.size(),
+                edge_data { s, get_super_final(), final_weight, eps, eps });
+        }
+    }
+
+    void rm_eps_state::expand_all()
+    {
+        for (int s = 0; s < input_vertex.size(); ++s) {
+            expand(s);
+        }
+    }
+
+    fst rm_eps(fst const& f, semiring_type type, double delta)
+    {
+        rm_eps_state state { f, type, delta };
+        state.expand_all();
+
+        return connect(state.result);
+    }
+
+    lazy_rm_eps_fst::lazy_rm_eps_fst(fst f, semiring_type type, double delta)
+    {
+        state = std::make_shared<rm_eps_state>(f, type, delta);
+    }
+
+}
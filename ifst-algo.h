@@ -0,0 +1,264 @@
+#ifndef IFST_ALGO_H
+#define IFST_ALGO_H
+
+#include "fst/ifst.h"
+
+namespace ifst {
+
+    /*
+     * Weights are scores, so `tropical` takes the max and `log` takes
+     * the log sum when paths are combined.
+     *
+     */
+    enum class semiring_type {
+        tropical,
+        log
+    };
+
+    /*
+     * Weighted determinization.  The (input, output) pair is treated
+     * as one label, so acceptors are determinized as usual and
+     * transducers come out with at most one edge per label pair
+     * leaving each vertex.  Residual weights are compared after
+     * rounding to multiples of `delta`.
+     *
+     * `ifst` has no final weights.  A final vertex whose residual
+     * weight is not zero gets an edge labeled `::fst::symbol_trait<int>::eps`
+     * to a shared final vertex, carrying that weight.
+     *
+     * As with any weighted determinization, this does not terminate
+     * on cyclic graphs that are not determinizable.
+     *
+     */
+    fst determinize(fst const& f, semiring_type type = semiring_type::tropical,
+        double delta = 1e-6);
+
+    /*
+     * The part of a lazily built fst found so far, in `result`, and how
+     * to build more.  `expand(v)` adds the out-edges of `v`, and
+     * `expand_all` builds everything.  `initials` and `finals` of
+     * `result` must be complete from the start.
+     *
+     */
+    struct lazy_expansion {
+        fst result;
+
+        virtual ~lazy_expansion();
+
+        virtual void expand(int v) = 0;
+        virtual void expand_all() = 0;
+    };
+
+    /*
+     * An fst built on demand.  A vertex is expanded the first time its
+     * out-edges (or out-edge maps) are requested, so the lazy fst can
+     * be put in front of composition without building everything.
+     * `vertices`, `edges`, `in_edges` and the in-edge maps need every
+     * vertex and expand everything.
+     *
+     * Copies share the expanded part.  A reference returned by an
+     * accessor is valid until the next call that expands a vertex.
+     *
+     */
+    struct lazy_expanded_fst {
+
+        using vertex = int;
+        using edge = int;
+        using input_symbol = int;
+        using output_symbol = int;
+
+        std::shared_ptr<lazy_expansion> state;
+
+        std::vector<int> const& vertices() const;
+        std::vector<int> const& edges() const;
+        double weight(int e) const;
+        std::vector<int> const& in_edges(int v) const;
+        std::vector<int> const& out_edges(int v) const;
+        int tail(int e) const;
+        int head(int e) const;
+        std::vector<int> const& initials() const;
+        std::vector<int> const& finals() const;
+        int const& input(int e) const;
+        int const& output(int e) const;
+
+        long time(int v) const;
+
+        std::unordered_map<int, std::vector<int>> const& in_edges_input_map(int v) const;
+        std::unordered_map<int, std::vector<int>> const& in_edges_output_map(int v) const;
+        std::unordered_map<int, std::vector<int>> const& out_edges_input_map(int v) const;
+        std::unordered_map<int, std::vector<int>> const& out_edges_output_map(int v) const;
+
+    };
+
+    /*
+     * Determinization on demand, as a `lazy_expanded_fst`.
+     *
+     * Unlike `determinize`, every vertex containing a final vertex has
+     * an eps edge to a single final vertex, even when its residual
+     * weight is zero, and is not final itself.  Whether a subset has a
+     * zero residual is only known once the subset is built, but
+     * `finals` has to be complete before any vertex is expanded, e.g.,
+     * `lazy_pair_fst` caches it on first use.  The extra edges have
+     * weight zero, so every label sequence keeps the score it has in
+     * `determinize`, with one more eps edge at the end.
+     *
+     */
+    struct lazy_determinized_fst
+        : public lazy_expanded_fst {
+
+        lazy_determinized_fst(fst f, semiring_type type = semiring_type::tropical,
+            double delta = 1e-6);
+
+    };
+
+    /*
+     * Builds a new fst from the vertices and edges of `f` listed in
+     * `vertices` and `edges`, numbered by their position in the lists.
+     * Every listed edge must have both ends listed.  Initials, finals,
+     * attributes and `feats` are carried over.
+     *
+     * `vertex_map` and `edge_map` are filled with the new id of each
+     * old id, or -1 for the ones left out.
+     *
+     */
+    fst remap(fst const& f, std::vector<int> const& vertices, std::vector<int> const& edges,
+        std::vector<int>& vertex_map, std::vector<int>& edge_map);
+
+    /*
+     * Removes the vertices that are not reachable from an initial
+     * vertex or cannot reach a final vertex, and the edges touching
+     * them.  Ids are compacted as in `remap`.  Runs in linear time.
+     *
+     */
+    fst connect(fst const& f, std::vector<int>& vertex_map, std::vector<int>& edge_map);
+    fst connect(fst const& f);
+
+    enum class vertex_order {
+        topological,
+        time
+    };
+
+    enum class edge_order {
+        by_tail,
+        by_head
+    };
+
+    /*
+     * Renumbers vertices in topological order (or by time, with ties
+     * in topological order), and edges grouped by tail (or by head) in
+     * the new vertex order, so that forward (or backward) passes walk
+     * the arrays of `fst_data` front to back.  Vertices not reachable
+     * from an initial vertex come last, in id order.
+     *
+     * The maps from old to new ids are returned as in `remap`.
+     *
+     */
+    fst renumber(fst const& f, vertex_order v_order, edge_order e_order,
+        std::vector<int>& vertex_map, std::vector<int>& edge_map);
+    fst renumber(fst const& f, vertex_order v_order = vertex_order::topological,
+        edge_order e_order = edge_order::by_tail);
+
+    /*
+     * Distances from the initials (`forward_distance`) or to the
+     * finals (`backward_distance`), indexed by vertex id, in the given
+     * semiring; -inf if there is no path.  Works on cyclic graphs, which
+     * in the tropical semiring must not have positive-weight cycles.
+     * In the log semiring, every path weight that arrives at a vertex
+     * is added to its value, but the vertex is only relaxed again once
+     * the weight not yet passed on changes its value by more than
+     * `delta`.  At the end, what a vertex has not passed on is about
+     * a fraction `delta` of its value at most.
+     *
+     */
+    std::vector<double> forward_distance(fst const& f,
+        semiring_type type = semiring_type::tropical, double delta = 1e-6);
+    std::vector<double> backward_distance(fst const& f,
+        semiring_type type = semiring_type::tropical, double delta = 1e-6);
+
+    /*
+     * Moves weights toward the initial vertices, so that the best
+     * (tropical) or total (log) weight leaving every vertex is zero.
+     *
+     * Final vertices that have paths leaving them get an eps edge to a
+     * new final vertex to hold what would otherwise be a final weight.
+     * Unless `remove_total` is set, the total weight of each initial
+     * vertex is kept on its out-edges, or on an eps edge from a new
+     * initial vertex if the initial vertex is also final or has
+     * in-edges.  Path weights are then unchanged.
+     *
+     */
+    fst push_weights(fst const& f, semiring_type type = semiring_type::tropical,
+        bool remove_total = false, double delta = 1e-6);
+
+    /*
+     * Pushes weights, trims, and merges vertices that have the same
+     * future: same finality, same time, and the same (input, output,
+     * weight) edges going to merged vertices.  Weights are compared
+     * after rounding to multiples of `delta`.  The result is minimal
+     * if `f` is deterministic, and equivalent to `f` otherwise.
+     *
+     * Acyclic graphs are minimized in one pass in reverse topological
+     * order, cyclic ones by partition refinement.
+     *
+     */
+    fst minimize(fst const& f, semiring_type type = semiring_type::tropical,
+        double delta = 1e-6);
+
+    /*
+     * Forward-backward pruning.  An edge is kept if the best (tropical)
+     * or total (log) weight of the paths through it, forward distance
+     * of the tail plus the edge weight plus backward distance of the
+     * head, is within `beam` of the best or total weight of `f`.  Unlike
+     * `beam_prune`, both sides of the edge are taken into account.
+     *
+     * The result is trimmed and renumbered as in `connect`, with the
+     * maps from old to new ids in `vertex_map` and `edge_map`.
+     *
+     */
+    fst posterior_prune(fst const& f, double beam, semiring_type type,
+        std::vector<int>& vertex_map, std::vector<int>& edge_map);
+    fst posterior_prune(fst const& f, double beam,
+        semiring_type type = semiring_type::tropical);
+
+    /*
+     * Epsilon removal.  An edge is an epsilon edge if both its input
+     * and output are `::fst::symbol_trait<int>::eps`.  Each vertex
+     * gets the non-epsilon edges of every vertex in its epsilon
+     * closure, weighted by the closure distance.  Attributes and
+     * `feats` of the edges are carried over.
+     *
+     * As in `determinize`, a vertex whose epsilon closure reaches a
+     * final vertex with a weight other than zero gets an eps edge to a
+     * shared final vertex carrying that weight; these are the only
+     * epsilon edges left.  The result is trimmed with `connect`.
+     *
+     * Epsilon self-loops, e.g., from `add_eps_loops`, are ignored in
+     * the tropical semiring, where they cannot improve a path.  In the
+     * log semiring epsilon cycles must have negative weight.
+     *
+     */
+    fst rm_eps(fst const& f, semiring_type type = semiring_type::tropical,
+        double delta = 1e-6);
+
+    /*
+     * Epsilon removal on demand, as a `lazy_expanded_fst`.  The edges
+     * are the same as those of `rm_eps` before trimming, so the only
+     * epsilon edges are the ones to the shared final vertex, for
+     * vertices whose weight to a final vertex is not zero.
+     *
+     * To know `finals` from the start, the epsilon closure of every
+     * vertex that reaches a final vertex through epsilon edges alone is
+     * computed when the lazy fst is created.
+     *
+     */
+    struct lazy_rm_eps_fst
+        : public lazy_expanded_fst {
+
+        lazy_rm_eps_fst(fst f, semiring_type type = semiring_type::tropical,
+            double delta = 1e-6);
+
+    };
+
+}
+
+#endif
@@ -0,0 +1,86 @@
+namespace ifst {
+
+    template <class fst_type, class time_fn, class edge_filter>
+    void stream_expand(fst_type const& f, stream_writer& w, time_fn time, edge_filter keep)
+    {
+        using vertex = typename fst_type::vertex;
+
+        std::unordered_map<vertex, int> ids;
+        std::deque<std::pair<vertex, int>> queue;
+
+        auto id = [&](vertex const& v) {
+            auto iter = ids.find(v);
+
+            if (iter != ids.end()) {
+                return iter->second;
+            }
+
+            int i = ids.size();
+            ids[v] = i;
+            w.add_vertex(time(v));
+            queue.push_back(std::make_pair(v, i));
+
+            return i;
+        };
+
+        for (auto& v: f.initials()) {
+            w.add_initial(id(v));
+        }
+
+        while (queue.size() > 0) {
+            vertex u = queue.front().first;
+            int tail = queue.front().second;
+            queue.pop_front();
+
+            for (auto& e: f.out_edges(u)) {
+                if (!keep(e)) {
+                    continue;
+                }
+
+                int head = id(f.head(e));
+
+                w.add_edge(edge_data { tail, head, f.weight(e), f.input(e), f.output(e) });
+            }
+        }
+
+        for (auto& v: f.finals()) {
+            auto iter = ids.find(v);
+
+            if (iter != ids.end()) {
+                w.add_final(iter->second);
+            }
+        }
+
+        w.close();
+    }
+
+    template <class fst_type, class time_fn>
+    void stream_expand(fst_type const& f, stream_writer& w, time_fn time)
+    {
+        using edge = typename fst_type::edge;
+
+        stream_expand(f, w, time, [](edge const&) { return true; });
+    }
+
+    template <class fst_type>
+    void stream_expand(fst_type const& f, stream_writer& w)
+    {
+        using vertex = typename fst_type::vertex;
+
+        stream_expand(f, w, [](vertex const&) { return 0L; });
+    }
+
+    template <class fst_type>
+    void stream_edges(fst_type const& f, std::vector<typename fst_type::edge> const& edges,
+        stream_writer& w)
+    {
+        using vertex = typename fst_type::vertex;
+        using edge = typename fst_type::edge;
+
+        std::unordered_set<edge> kept { edges.begin(), edges.end() };
+
+        stream_expand(f, w, [](vertex const&) { return 0L; },
+            [&](edge const& e) { return kept.count(e) > 0; });
+    }
+
+}
@@ -0,0 +1,1529 @@
+#include "fst/ifst-io.h"
+#include "fst/fst.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+namespace ifst {
+
+    mapped_file::mapped_file(std::string const& filename, bool sequential)
+        : data(nullptr), size(0)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+
+        if (fd == -1) {
+            std::cerr << "unable to open " << filename << std::endl;
+            exit(1);
+        }
+
+        struct stat st;
+
+        if (fstat(fd, &st) == -1) {
+            std::cerr << "unable to stat " << filename << std::endl;
+            exit(1);
+        }
+
+        size = st.st_size;
+
+        if (size > 0) {
+            void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (p == MAP_FAILED) {
+                std::cerr << "unable to map " << filename << std::endl;
+                exit(1);
+            }
+
+            madvise(p, size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+            data = static_cast<char const*>(p);
+        }
+
+        close(fd);
+    }
+
+    mapped_file::~mapped_file()
+    {
+        if (data != nullptr) {
+            munmap(const_cast<char*>(data), size);
+        }
+    }
+
+    namespace {
+
+        struct token {
+            char const *begin;
+            int size;
+        };
+
+        /*
+         * Splits the line starting at `p` into at most `max` tokens and
+         * returns the number of tokens, or `max + 1` if there are more.
+         * `p` is left at the start of the next line.
+         *
+         */
+        int split_line(char const *& p, char const *end, token *tokens, int max)
+        {
+            int n = 0;
+
+            while (p < end && *p != '\n') {
+                if (*p == ' ' || *p == '\t' || *p == '\r') {
+                    ++p;
+                    continue;
+                }
+
+                char const *begin = p;
+
+                while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+                    ++p;
+                }
+
+                if (n < max) {
+                    tokens[n] = token { begin, int(p - begin) };
+                }
+
+                ++n;
+            }
+
+            if (p < end) {
+                ++p;
+            }
+
+            return std::min(n, max + 1);
+        }
+
+        bool parse_int(token const& t, int& result)
+        {
+            if (t.size == 0 || t.size > 9) {
+                return false;
+            }
+
+            int value = 0;
+
+            for (int i = 0; i < t.size; ++i) {
+                if (t.begin[i] < '0' || t.begin[i] > '9') {
+                    return false;
+                }
+
+                value = value * 10 + (t.begin[i] - '0');
+            }
+
+            result = value;
+
+            return true;
+        }
+
+        /*
+         * The token is copied to a buffer on the stack, because the
+         * mapped text is not null-terminated.
+         *
+         */
+        bool parse_double(token const& t, double& result)
+        {
+            char buf[64];
+
+            if (t.size == 0 || t.size >= sizeof(buf)) {
+                return false;
+            }
+
+            std::memcpy(buf, t.begin, t.size);
+            buf[t.size] = '\0';
+
+            char *end;
+            result = std::strtod(buf, &end);
+
+            return end == buf + t.size;
+        }
+
+        /*
+         * An open-addressing hash from symbols to ids over the strings
+         * of `id_symbol`, so that a token can be looked up without
+         * making a `std::string` out of it.
+         *
+         */
+        struct symbol_index {
+
+            std::vector<std::string> const *id_symbol;
+            std::vector<int> slots;
+            unsigned long mask;
+
+            static unsigned long hash(char const *p, int size)
+            {
+                unsigned long h = 14695981039346656037ul;
+
+                for (int i = 0; i < size; ++i) {
+                    h = (h ^ (unsigned char) p[i]) * 1099511628211ul;
+                }
+
+                return h;
+            }
+
+            symbol_index(std::vector<std::string> const& id_symbol)
+                : id_symbol(&id_symbol)
+            {
+                unsigned long size = 16;
+
+                while (size < 2 * id_symbol.size()) {
+                    size *= 2;
+                }
+
+                slots.resize(size, -1);
+                mask = size - 1;
+
+                for (int i = 0; i < id_symbol.size(); ++i) {
+                    std::string const& s = id_symbol[i];
+
+                    if (s.size() == 0) {
+                        continue;
+                    }
+
+                    unsigned long k = hash(s.data(), s.size()) & mask;
+
+                    while (slots[k] != -1) {
+                        k = (k + 1) & mask;
+                    }
+
+                    slots[k] = i;
+                }
+            }
+
+            int find(token const& t) const
+            {
+                unsigned long k = hash(t.begin, t.size) & mask;
+
+                while (slots[k] != -1) {
+                    std::string const& s = (*id_symbol)[slots[k]];
+
+                    if (s.size() == t.size && std::memcmp(s.data(), t.begin, t.size) == 0) {
+                        return slots[k];
+                    }
+
+                    k = (k + 1) & mask;
+                }
+
+                return -1;
+            }
+
+        };
+
+        struct chunk_result {
+            std::vector<edge_data> edges;
+            std::vector<std::pair<int, double>> finals;
+            int first_vertex = -1;
+            int max_vertex = -1;
+
+            char const *error_pos = nullptr;
+            char const *error = nullptr;
+        };
+
+        void parse_chunk(char const *begin, char const *end, symbol_index const *symbols,
+            bool acceptor, chunk_result& result)
+        {
+            token tokens[5];
+
+            int max_tokens = acceptor ? 4 : 5;
+
+            auto parse_label = [&](token const& t, int& label) {
+                if (symbols == nullptr) {
+                    return parse_int(t, label);
+                }
+
+                label = symbols->find(t);
+
+                return label != -1;
+            };
+
+            char const *p = begin;
+
+            while (p < end) {
+                char const *line = p;
+                int n = split_line(p, end, tokens, max_tokens);
+
+                if (n == 0) {
+                    continue;
+                }
+
+                auto fail = [&](char const *message) {
+                    result.error_pos = line;
+                    result.error = message;
+                };
+
+                int tail;
+
+                if (!parse_int(tokens[0], tail)) {
+                    fail("bad vertex");
+                    return;
+                }
+
+                if (result.first_vertex == -1) {
+                    result.first_vertex = tail;
+                }
+
+                result.max_vertex = std::max(result.max_vertex, tail);
+
+                if (n <= 2) {
+                    double cost = 0;
+
+                    if (n == 2 && !parse_double(tokens[1], cost)) {
+                        fail("bad final weight");
+                        return;
+                    }
+
+                    result.finals.push_back(std::make_pair(tail, -cost));
+
+                    continue;
+                }
+
+                int nlabels = acceptor ? 1 : 2;
+
+                if (n != 2 + nlabels && n != 3 + nlabels) {
+                    fail("wrong number of fields");
+                    return;
+                }
+
+                edge_data e;
+                e.tail = tail;
+
+                if (!parse_int(tokens[1], e.head)) {
+                    fail("bad vertex");
+                    return;
+                }
+
+                if (!parse_label(tokens[2], e.input)) {
+                    fail(symbols == nullptr ? "bad label" : "unknown symbol");
+                    return;
+                }
+
+                if (acceptor) {
+                    e.output = e.input;
+                } else if (!parse_label(tokens[3], e.output)) {
+                    fail(symbols == nullptr ? "bad label" : "unknown symbol");
+                    return;
+                }
+
+                double cost = 0;
+
+                if (n == 3 + nlabels && !parse_double(tokens[2 + nlabels], cost)) {
+                    fail("bad weight");
+                    return;
+                }
+
+                e.weight = -cost;
+
+                result.max_vertex = std::max(result.max_vertex, e.head);
+                result.edges.push_back(e);
+            }
+        }
+
+    }
+
+    symbol_table load_symbol_table(std::string const& filename)
+    {
+        mapped_file file { filename };
+
+        symbol_table result;
+        result.symbol_id = std::make_shared<std::unordered_map<std::string, int>>();
+        result.id_symbol = std::make_shared<std::vector<std::string>>();
+
+        char const *p = file.data;
+        char const *end = file.data + file.size;
+
+        token tokens[2];
+        int line = 0;
+
+        while (p < end) {
+            ++line;
+
+            int n = split_line(p, end, tokens, 2);
+
+            if (n == 0) {
+                continue;
+            }
+
+            int id;
+
+            if (n != 2 || !parse_int(tokens[1], id)) {
+                std::cerr << filename << ": line " << line << ": bad symbol" << std::endl;
+                exit(1);
+            }
+
+            std::string symbol { tokens[0].begin, std::string::size_type(tokens[0].size) };
+
+            if (id >= result.id_symbol->size()) {
+                result.id_symbol->resize(id + 1);
+            }
+
+            (*result.id_symbol)[id] = symbol;
+            (*result.symbol_id)[symbol] = id;
+        }
+
+        return result;
+    }
+
+    fst parse_text(char const *text, long size, symbol_table const *symbols,
+        bool acceptor, int nthreads)
+    {
+        std::shared_ptr<symbol_index> index;
+
+        if (symbols != nullptr) {
+            index = std::make_shared<symbol_index>(*symbols->id_symbol);
+        }
+
+        nthreads = std::max<long>(1, std::min<long>(nthreads, size / 4096 + 1));
+
+        // Chunk boundaries are moved forward to the start of a line.
+
+        std::vector<char const*> bounds { text };
+
+        for (int i = 1; i < nthreads; ++i) {
+            char const *p = std::max(text + size * i / nthreads, bounds.back());
+            p = static_cast<char const*>(std::memchr(p, '\n', text + size - p));
+            bounds.push_back(p == nullptr ? text + size : p + 1);
+        }
+
+        bounds.push_back(text + size);
+
+        std::vector<chunk_result> chunks(nthreads);
+        std::vector<std::thread> threads;
+
+        for (int i = 1; i < nthreads; ++i) {
+            threads.emplace_back(parse_chunk, bounds[i], bounds[i + 1], index.get(),
+                acceptor, std::ref(chunks[i]));
+        }
+
+        parse_chunk(bounds[0], bounds[1], index.get(), acceptor, chunks[0]);
+
+        for (auto& t: threads) {
+            t.join();
+        }
+
+        int initial = -1;
+        int max_vertex = -1;
+        long nedges = 0;
+
+        for (auto& c: chunks) {
+            if (c.error != nullptr) {
+                long line = 1 + std::count(text, c.error_pos, '\n');
+                std::cerr << "line " << line << ": " << c.error << std::endl;
+                exit(1);
+            }
+
+            if (initial == -1) {
+                initial = c.first_vertex;
+            }
+
+            max_vertex = std::max(max_vertex, c.max_vertex);
+            nedges += c.edges.size();
+        }
+
+        std::vector<edge_data> edges;
+        edges.reserve(nedges);
+
+        for (auto& c: chunks) {
+            edges.insert(edges.end(), c.edges.begin(), c.edges.end());
+            c.edges = std::vector<edge_data> {};
+        }
+
+        int nvertices = max_vertex + 1;
+        int super_final = -1;
+
+        std::vector<int> finals;
+
+        for (auto& c: chunks) {
+            for (auto& p: c.finals) {
+                if (p.second == -std::numeric_limits<double>::infinity()) {
+                    continue;
+                }
+
+                if (p.second == 0) {
+                    finals.push_back(p.first);
+                    continue;
+                }
+
+                if (super_final == -1) {
+                    super_final = nvertices;
+                    ++nvertices;
+                }
+
+                edges.push_back(edge_data { p.first, super_final, p.second,
+                    ::fst::symbol_trait<int>::eps, ::fst::symbol_trait<int>::eps });
+            }
+        }
+
+        if (super_final != -1) {
+            finals.push_back(super_final);
+        }
+
+        fst result;
+        result.data = std::make_shared<fst_data>();
+
+        bulk_build(*result.data, std::vector<vertex_data>(nvertices, vertex_data { 0 }),
+            std::move(edges), nthreads);
+
+        if (initial != -1) {
+            result.data->initials.push_back(initial);
+        }
+
+        result.data->finals = std::move(finals);
+
+        if (symbols != nullptr) {
+            result.data->symbol_id = symbols->symbol_id;
+            result.data->id_symbol = symbols->id_symbol;
+        }
+
+        return result;
+    }
+
+    fst load_text(std::string const& filename, bool acceptor, int nthreads)
+    {
+        mapped_file file { filename };
+
+        return parse_text(file.data, file.size, nullptr, acceptor, nthreads);
+    }
+
+    fst load_text(std::string const& filename, symbol_table const& symbols,
+        bool acceptor, int nthreads)
+    {
+        mapped_file file { filename };
+
+        return parse_text(file.data, file.size, &symbols, acceptor, nthreads);
+    }
+
+
+    binary_writer::binary_writer(std::ostream& os)
+        : os(os), bytes(0)
+    {
+        buffer.reserve(buffer_size);
+    }
+
+    binary_writer::~binary_writer()
+    {
+        flush();
+    }
+
+    void binary_writer::flush()
+    {
+        os.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+    void binary_writer::write(void const *p, long size)
+    {
+        char const *c = static_cast<char const*>(p);
+
+        bytes += size;
+
+        if (buffer.size() + size > buffer_size) {
+            flush();
+
+            if (size > buffer_size) {
+                os.write(c, size);
+                return;
+            }
+        }
+
+        buffer.insert(buffer.end(), c, c + size);
+    }
+
+    void binary_writer::write_varint(uint64_t v)
+    {
+        char buf[10];
+        int n = 0;
+
+        while (v >= 0x80) {
+            buf[n] = char(v | 0x80);
+            v >>= 7;
+            ++n;
+        }
+
+        buf[n] = char(v);
+
+        write(buf, n + 1);
+    }
+
+    void binary_writer::write_string(std::string const& s)
+    {
+        write(uint32_t(s.size()));
+        write(s.data(), s.size());
+    }
+
+    namespace {
+
+        uint32_t const record_magic = 0x31545346;    // "FST1"
+
+        struct record_footer {
+            uint64_t edges_bytes;
+            uint64_t nvertices;
+            uint64_t nedges;
+            uint64_t ninitials;
+            uint64_t nfinals;
+            uint64_t name_bytes;
+            uint64_t vertex_attrs_bytes;
+            uint64_t edge_attrs_bytes;
+            uint64_t feats_bytes;
+            uint32_t encoding;
+            uint32_t magic;
+        };
+
+        char const archive_magic[8] = { 'I', 'F', 'S', 'T', 'A', 'R', 'C', '1' };
+        char const index_magic[8] = { 'I', 'F', 'S', 'T', 'I', 'D', 'X', '1' };
+
+        [[noreturn]] void corrupt(char const *what)
+        {
+            std::cerr << "corrupt binary fst: " << what << std::endl;
+            exit(1);
+        }
+
+        /*
+         * Reads from a buffer, checking that nothing is read past `end`.
+         */
+        struct binary_reader {
+
+            char const *p;
+            char const *end;
+
+            void read(void *dest, long size)
+            {
+                if (end - p < size) {
+                    corrupt("truncated");
+                } else if (size == 0) {
+                    return;
+                }
+
+                std::memcpy(dest, p, size);
+                p += size;
+            }
+
+            template <class T>
+            T read()
+            {
+                T t;
+                read(&t, sizeof(T));
+                return t;
+            }
+
+            uint64_t read_varint()
+            {
+                if (p < end && (unsigned char) *p < 0x80) {
+                    return (unsigned char) *p++;
+                }
+
+                uint64_t v = 0;
+
+                for (int shift = 0; shift < 64; shift += 7) {
+                    if (p == end) {
+                        corrupt("truncated");
+                    }
+
+                    unsigned char c = *p++;
+                    v |= uint64_t(c & 0x7f) << shift;
+
+                    if (c < 0x80) {
+                        return v;
+                    }
+                }
+
+                corrupt("bad varint");
+            }
+
+            std::string read_string()
+            {
+                uint32_t size = read<uint32_t>();
+
+                if (end - p < size) {
+                    corrupt("truncated");
+                }
+
+                std::string result { p, size };
+                p += size;
+
+                return result;
+            }
+
+        };
+
+        uint64_t zigzag(int64_t n)
+        {
+            return (uint64_t(n) << 1) ^ uint64_t(n >> 63);
+        }
+
+        int64_t unzigzag(uint64_t n)
+        {
+            return int64_t(n >> 1) ^ -int64_t(n & 1);
+        }
+
+        /*
+         * Quantized weights are multiples of the step, with the extremes
+         * of int64_t standing for the infinities.
+         */
+        int64_t quantize(double w, double step)
+        {
+            if (w == -std::numeric_limits<double>::infinity()) {
+                return std::numeric_limits<int64_t>::min();
+            } else if (w == std::numeric_limits<double>::infinity()) {
+                return std::numeric_limits<int64_t>::max();
+            } else if (std::isnan(w) || std::fabs(w / step) > 1e18) {
+                std::cerr << "unable to quantize weight " << w << std::endl;
+                exit(1);
+            }
+
+            return std::llround(w / step);
+        }
+
+        double dequantize(int64_t q, double step)
+        {
+            if (q == std::numeric_limits<int64_t>::min()) {
+                return -std::numeric_limits<double>::infinity();
+            } else if (q == std::numeric_limits<int64_t>::max()) {
+                return std::numeric_limits<double>::infinity();
+            }
+
+            return q * step;
+        }
+
+        void write_compact_edge(binary_writer& w, edge_data const& e, int& prev_tail, double weight_step)
+        {
+            w.write_varint(zigzag(int64_t(e.tail) - prev_tail));
+            w.write_varint(zigzag(int64_t(e.head) - e.tail));
+            w.write_varint(zigzag(e.input));
+            w.write_varint(zigzag(int64_t(e.output) - e.input));
+
+            if (weight_step > 0) {
+                w.write_varint(zigzag(quantize(e.weight, weight_step)));
+            } else {
+                w.write(e.weight);
+            }
+
+            prev_tail = e.tail;
+        }
+
+        void read_compact_edges(binary_reader& r, std::vector<edge_data>& edges)
+        {
+            double step = r.read<double>();
+
+            int64_t tail = 0;
+
+            for (auto& e: edges) {
+                tail += unzigzag(r.read_varint());
+                int64_t head = tail + unzigzag(r.read_varint());
+                int64_t input = unzigzag(r.read_varint());
+                int64_t output = input + unzigzag(r.read_varint());
+
+                if (tail < 0 || tail > std::numeric_limits<int>::max()
+                        || head < 0 || head > std::numeric_limits<int>::max()) {
+                    corrupt("vertex out of range");
+                }
+
+                e.tail = tail;
+                e.head = head;
+                e.input = input;
+                e.output = output;
+
+                if (step > 0) {
+                    e.weight = dequantize(unzigzag(r.read_varint()), step);
+                } else {
+                    e.weight = r.read<double>();
+                }
+            }
+        }
+
+        bool dense(std::vector<int> const& indices, long size)
+        {
+            if (indices.size() != size) {
+                return false;
+            }
+
+            for (int i = 0; i < indices.size(); ++i) {
+                if (indices[i] != i) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        /*
+         * Attributes are stored only for the ids that have any, as
+         * a count followed by (id, number of pairs, pairs).
+         *
+         */
+        long write_attrs(binary_writer& w,
+            std::vector<std::vector<std::pair<std::string, std::string>>> const& attrs,
+            std::vector<int> const& ids, std::vector<int> const& id_map)
+        {
+            long start = w.bytes;
+
+            uint32_t n = 0;
+
+            for (auto& i: ids) {
+                if (i < attrs.size() && attrs[i].size() > 0) {
+                    ++n;
+                }
+            }
+
+            w.write(n);
+
+            for (auto& i: ids) {
+                if (i < attrs.size() && attrs[i].size() > 0) {
+                    w.write(int32_t(id_map[i]));
+                    w.write(uint32_t(attrs[i].size()));
+
+                    for (auto& p: attrs[i]) {
+                        w.write_string(p.first);
+                        w.write_string(p.second);
+                    }
+                }
+            }
+
+            return w.bytes - start;
+        }
+
+        void read_attrs(binary_reader r,
+            std::vector<std::vector<std::pair<std::string, std::string>>>& attrs)
+        {
+            uint32_t n = r.read<uint32_t>();
+
+            for (uint32_t k = 0; k < n; ++k) {
+                int32_t i = r.read<int32_t>();
+                uint32_t m = r.read<uint32_t>();
+
+                if (i < 0 || i >= attrs.size()) {
+                    corrupt("attribute id out of range");
+                }
+
+                for (uint32_t j = 0; j < m; ++j) {
+                    std::string key = r.read_string();
+                    attrs[i].push_back(std::make_pair(std::move(key), r.read_string()));
+                }
+            }
+        }
+
+    }
+
+    long write_binary(std::ostream& os, fst const& f,
+        binary_encoding encoding, double weight_step)
+    {
+        fst_data const& data = *f.data;
+
+        static_assert(sizeof(edge_data) == 24, "edge_data is written as it is in memory");
+
+        binary_writer w { os };
+        record_footer footer {};
+
+        // Ids as stored, the identity when they are already dense.
+
+        std::vector<int> vertex_map(data.vertices.size(), -1);
+        std::vector<int> edge_map(data.edges.size(), -1);
+
+        for (int i = 0; i < data.vertex_indices.size(); ++i) {
+            vertex_map[data.vertex_indices[i]] = i;
+        }
+
+        for (int i = 0; i < data.edge_indices.size(); ++i) {
+            edge_map[data.edge_indices[i]] = i;
+        }
+
+        bool ids_dense = dense(data.edge_indices, data.edges.size())
+            && dense(data.vertex_indices, data.vertices.size());
+
+        if (encoding == binary_encoding::compact) {
+            w.write(weight_step > 0 ? weight_step : 0.0);
+
+            int prev_tail = 0;
+
+            for (auto& e: data.edge_indices) {
+                edge_data d = data.edges[e];
+                d.tail = vertex_map[d.tail];
+                d.head = vertex_map[d.head];
+                write_compact_edge(w, d, prev_tail, weight_step);
+            }
+        } else if (ids_dense) {
+            w.write(data.edges.data(), long(data.edges.size()) * sizeof(edge_data));
+        } else {
+            for (auto& e: data.edge_indices) {
+                edge_data d = data.edges[e];
+                d.tail = vertex_map[d.tail];
+                d.head = vertex_map[d.head];
+                w.write(d);
+            }
+        }
+
+        footer.edges_bytes = w.bytes;
+        footer.nedges = data.edge_indices.size();
+
+        long prev_time = 0;
+
+        for (auto& v: data.vertex_indices) {
+            if (encoding == binary_encoding::compact) {
+                w.write_varint(zigzag(data.vertices[v].time - prev_time));
+                prev_time = data.vertices[v].time;
+            } else {
+                w.write(int64_t(data.vertices[v].time));
+            }
+        }
+
+        footer.nvertices = data.vertex_indices.size();
+
+        for (auto& v: data.initials) {
+            w.write(int32_t(vertex_map[v]));
+        }
+
+        footer.ninitials = data.initials.size();
+
+        for (auto& v: data.finals) {
+            w.write(int32_t(vertex_map[v]));
+        }
+
+        footer.nfinals = data.finals.size();
+
+        w.write(data.name.data(), data.name.size());
+        footer.name_bytes = data.name.size();
+
+        footer.vertex_attrs_bytes = write_attrs(w, data.vertex_attrs, data.vertex_indices, vertex_map);
+        footer.edge_attrs_bytes = write_attrs(w, data.edge_attrs, data.edge_indices, edge_map);
+
+        long start = w.bytes;
+
+        uint32_t nfeats = 0;
+
+        for (auto& e: data.edge_indices) {
+            if (e < data.feats.size() && data.feats[e].size() > 0) {
+                ++nfeats;
+            }
+        }
+
+        w.write(nfeats);
+
+        for (auto& e: data.edge_indices) {
+            if (e < data.feats.size() && data.feats[e].size() > 0) {
+                w.write(int32_t(edge_map[e]));
+                w.write(uint32_t(data.feats[e].size()));
+                w.write(data.feats[e].data(), long(data.feats[e].size()) * sizeof(double));
+            }
+        }
+
+        footer.feats_bytes = w.bytes - start;
+        footer.encoding = uint32_t(encoding);
+        footer.magic = record_magic;
+
+        w.write(footer);
+        w.flush();
+
+        return w.bytes;
+    }
+
+    namespace {
+
+        /*
+         * Checks the footer and decodes the edges, vertex times,
+         * initials and finals.  The reader is left at the name.
+         *
+         */
+        binary_reader read_record_arrays(char const *data, long size, record_footer& footer,
+            std::vector<vertex_data>& vertices, std::vector<edge_data>& edges,
+            std::vector<int>& initials, std::vector<int>& finals)
+        {
+            if (size < sizeof(record_footer)) {
+                corrupt("truncated");
+            }
+
+            std::memcpy(&footer, data + size - sizeof(record_footer), sizeof(record_footer));
+
+            if (footer.magic != record_magic) {
+                corrupt("bad magic");
+            }
+
+            if (footer.encoding != uint32_t(binary_encoding::raw)
+                    && footer.encoding != uint32_t(binary_encoding::compact)) {
+                corrupt("unknown encoding");
+            }
+
+            bool compact = footer.encoding == uint32_t(binary_encoding::compact);
+
+            binary_reader r { data, data + size - sizeof(record_footer) };
+
+            // Every count is checked against the bytes left before anything
+            // is allocated, so a corrupt footer cannot ask for more memory
+            // than the record has.  Each edge takes at least one byte.
+
+            if (footer.edges_bytes > r.end - r.p || footer.nedges > footer.edges_bytes
+                    || (!compact && footer.edges_bytes != footer.nedges * sizeof(edge_data))) {
+                corrupt("bad edge section");
+            }
+
+            edges.resize(footer.nedges);
+
+            if (compact) {
+                binary_reader edge_reader { r.p, r.p + footer.edges_bytes };
+                read_compact_edges(edge_reader, edges);
+
+                if (edge_reader.p != edge_reader.end) {
+                    corrupt("bad edge section");
+                }
+
+                r.p = edge_reader.end;
+            } else {
+                r.read(edges.data(), footer.edges_bytes);
+            }
+
+            if (footer.nvertices > r.end - r.p) {
+                corrupt("bad vertex section");
+            }
+
+            vertices.resize(footer.nvertices);
+
+            long time = 0;
+
+            for (auto& v: vertices) {
+                if (compact) {
+                    time += unzigzag(r.read_varint());
+                    v.time = time;
+                } else {
+                    v.time = r.read<int64_t>();
+                }
+            }
+
+            for (auto& e: edges) {
+                if (e.tail < 0 || e.tail >= vertices.size() || e.head < 0 || e.head >= vertices.size()) {
+                    corrupt("vertex out of range");
+                }
+            }
+
+            if (footer.ninitials > (r.end - r.p) / sizeof(int32_t)) {
+                corrupt("bad initial section");
+            }
+
+            initials.resize(footer.ninitials);
+            r.read(initials.data(), footer.ninitials * sizeof(int32_t));
+
+            if (footer.nfinals > (r.end - r.p) / sizeof(int32_t)) {
+                corrupt("bad final section");
+            }
+
+            finals.resize(footer.nfinals);
+            r.read(finals.data(), footer.nfinals * sizeof(int32_t));
+
+            for (auto& v: initials) {
+                if (v < 0 || v >= vertices.size()) {
+                    corrupt("initial out of range");
+                }
+            }
+
+            for (auto& v: finals) {
+                if (v < 0 || v >= vertices.size()) {
+                    corrupt("final out of range");
+                }
+            }
+
+            return r;
+        }
+
+    }
+
+    void read_binary_arrays(char const *data, long size,
+        std::vector<vertex_data>& vertices, std::vector<edge_data>& edges,
+        std::vector<int>& initials, std::vector<int>& finals)
+    {
+        record_footer footer;
+        read_record_arrays(data, size, footer, vertices, edges, initials, finals);
+    }
+
+    fst read_binary(char const *data, long size, int nthreads)
+    {
+        record_footer footer;
+        std::vector<vertex_data> vertices;
+        std::vector<edge_data> edges;
+        std::vector<int> initials;
+        std::vector<int> finals;
+
+        binary_reader r = read_record_arrays(data, size, footer,
+            vertices, edges, initials, finals);
+
+        if (footer.name_bytes > r.end - r.p) {
+            corrupt("bad name");
+        }
+
+        std::string name(footer.name_bytes, '\0');
+        r.read(&name[0], footer.name_bytes);
+
+        fst result;
+        result.data = std::make_shared<fst_data>();
+
+        bulk_build(*result.data, std::move(vertices), std::move(edges), nthreads);
+
+        result.data->initials = std::move(initials);
+        result.data->finals = std::move(finals);
+        result.data->name = std::move(name);
+
+        char const *sections = r.p;
+
+        if (r.end - sections != footer.vertex_attrs_bytes + footer.edge_attrs_bytes
+                + footer.feats_bytes) {
+            corrupt("bad section sizes");
+        }
+
+        read_attrs(binary_reader { sections, sections + footer.vertex_attrs_bytes },
+            result.data->vertex_attrs);
+
+        sections += footer.vertex_attrs_bytes;
+
+        read_attrs(binary_reader { sections, sections + footer.edge_attrs_bytes },
+            result.data->edge_attrs);
+
+        sections += footer.edge_attrs_bytes;
+
+        binary_reader feats { sections, r.end };
+
+        uint32_t nfeats = feats.read<uint32_t>();
+
+        for (uint32_t k = 0; k < nfeats; ++k) {
+            int32_t e = feats.read<int32_t>();
+            uint32_t dim = feats.read<uint32_t>();
+
+            if (e < 0 || e >= result.data->feats.size()) {
+                corrupt("feature id out of range");
+            }
+
+            if (dim > (feats.end - feats.p) / sizeof(double)) {
+                corrupt("bad feature size");
+            }
+
+            result.data->feats[e].resize(dim);
+            feats.read(result.data->feats[e].data(), long(dim) * sizeof(double));
+        }
+
+        return result;
+    }
+
+    void save_binary(std::string const& filename, fst const& f,
+        binary_encoding encoding, double weight_step)
+    {
+        std::ofstream ofs { filename, std::ios::binary };
+
+        if (!ofs) {
+            std::cerr << "unable to open " << filename << std::endl;
+            exit(1);
+        }
+
+        write_binary(ofs, f, encoding, weight_step);
+        ofs.close();
+
+        if (!ofs) {
+            std::cerr << "unable to write " << filename << std::endl;
+            exit(1);
+        }
+    }
+
+    fst load_binary(std::string const& filename, int nthreads)
+    {
+        mapped_file file { filename };
+
+        return read_binary(file.data, file.size, nthreads);
+    }
+
+    archive_writer::archive_writer(std::string const& filename,
+        binary_encoding encoding, double weight_step)
+        : filename(filename), ofs(filename, std::ios::binary), offset(0), closed(false)
+        , encoding(encoding), weight_step(weight_step)
+    {
+        if (!ofs) {
+            std::cerr << "unable to open " << filename << std::endl;
+            exit(1);
+        }
+
+        ofs.write(archive_magic, sizeof(archive_magic));
+        offset = sizeof(archive_magic);
+    }
+
+    archive_writer::~archive_writer()
+    {
+        close();
+    }
+
+    void archive_writer::add(std::string const& key, fst const& f)
+    {
+        // Records start at multiples of 8, so that the edges in the
+        // mapping are aligned.
+
+        char const zeros[8] = {};
+
+        ofs.write(zeros, (8 - offset % 8) % 8);
+        offset += (8 - offset % 8) % 8;
+
+        long size = write_binary(ofs, f, encoding, weight_step);
+
+        if (!ofs) {
+            std::cerr << "unable to write " << key << " to " << filename << std::endl;
+            exit(1);
+        }
+
+        index.push_back(entry { key, offset, size });
+        offset += size;
+    }
+
+    void archive_writer::close()
+    {
+        if (closed) {
+            return;
+        }
+
+        binary_writer w { ofs };
+
+        for (auto& e: index) {
+            w.write(int64_t(e.offset));
+            w.write(int64_t(e.size));
+            w.write_string(e.key);
+        }
+
+        w.write(int64_t(offset));
+        w.write(int64_t(index.size()));
+        w.write(index_magic, sizeof(index_magic));
+        w.flush();
+
+        ofs.close();
+        closed = true;
+
+        if (!ofs) {
+            std::cerr << "unable to write the index of " << filename << std::endl;
+            exit(1);
+        }
+    }
+
+    archive_reader::archive_reader(std::string const& filename)
+        : file(filename, false)
+    {
+        long trailer = 2 * sizeof(int64_t) + sizeof(index_magic);
+
+        if (file.size < sizeof(archive_magic) + trailer
+                || std::memcmp(file.data, archive_magic, sizeof(archive_magic)) != 0
+                || std::memcmp(file.data + file.size - sizeof(index_magic),
+                    index_magic, sizeof(index_magic)) != 0) {
+            std::cerr << filename << ": not an archive, or not closed" << std::endl;
+            exit(1);
+        }
+
+        binary_reader t { file.data + file.size - trailer, file.data + file.size };
+        int64_t index_offset = t.read<int64_t>();
+        int64_t n = t.read<int64_t>();
+
+        if (index_offset < 0 || index_offset > file.size - trailer) {
+            corrupt("bad index offset");
+        }
+
+        binary_reader r { file.data + index_offset, file.data + file.size - trailer };
+
+        // An entry takes at least an offset, a size and a key length.
+
+        if (n < 0 || n > (r.end - r.p) / (2 * sizeof(int64_t) + sizeof(uint32_t))) {
+            corrupt("bad index size");
+        }
+
+        index.reserve(n);
+        positions.reserve(n);
+
+        for (int64_t i = 0; i < n; ++i) {
+            archive_writer::entry e;
+            e.offset = r.read<int64_t>();
+            e.size = r.read<int64_t>();
+            e.key = r.read_string();
+
+            if (e.offset < 0 || e.size < 0 || e.offset > index_offset
+                    || e.size > index_offset - e.offset) {
+                corrupt("bad index entry");
+            }
+
+            positions[e.key] = i;
+            index.push_back(std::move(e));
+        }
+    }
+
+    int archive_reader::size() const
+    {
+        return index.size();
+    }
+
+    std::string const& archive_reader::key(int i) const
+    {
+        return index.at(i).key;
+    }
+
+    int archive_reader::position(std::string const& key) const
+    {
+        auto iter = positions.find(key);
+
+        return iter == positions.end() ? -1 : iter->second;
+    }
+
+    fst archive_reader::read(int i, int nthreads) const
+    {
+        archive_writer::entry const& e = index.at(i);
+
+        return read_binary(file.data + e.offset, e.size, nthreads);
+    }
+
+    fst archive_reader::read(std::string const& key, int nthreads) const
+    {
+        int i = position(key);
+
+        if (i == -1) {
+            std::cerr << "key " << key << " not in archive" << std::endl;
+            exit(1);
+        }
+
+        return read(i, nthreads);
+    }
+
+    std::pair<int, int> archive_reader::shard(int i, int n) const
+    {
+        return std::make_pair(long(size()) * i / n, long(size()) * (i + 1) / n);
+    }
+
+
+    binary_stream_writer::binary_stream_writer(std::ostream& os,
+        binary_encoding encoding, double weight_step)
+        : w(os), encoding(encoding), weight_step(weight_step)
+        , nedges(0), prev_tail(0), max_vertex(-1), closed(false)
+    {
+        if (encoding == binary_encoding::compact) {
+            w.write(weight_step > 0 ? weight_step : 0.0);
+        }
+    }
+
+    binary_stream_writer::~binary_stream_writer()
+    {
+        close();
+    }
+
+    void binary_stream_writer::add_vertex(long time)
+    {
+        times.push_back(time);
+    }
+
+    void binary_stream_writer::add_edge(edge_data const& e)
+    {
+        max_vertex = std::max(max_vertex, std::max(e.tail, e.head));
+
+        if (encoding == binary_encoding::compact) {
+            write_compact_edge(w, e, prev_tail, weight_step);
+        } else {
+            w.write(e);
+        }
+
+        ++nedges;
+    }
+
+    void binary_stream_writer::add_initial(int v)
+    {
+        max_vertex = std::max(max_vertex, v);
+        initials.push_back(v);
+    }
+
+    void binary_stream_writer::add_final(int v)
+    {
+        max_vertex = std::max(max_vertex, v);
+        finals.push_back(v);
+    }
+
+    void binary_stream_writer::close()
+    {
+        if (closed) {
+            return;
+        }
+
+        if (max_vertex >= long(times.size())) {
+            std::cerr << "vertex " << max_vertex << " used but not added" << std::endl;
+            exit(1);
+        }
+
+        record_footer footer {};
+
+        footer.edges_bytes = w.bytes;
+        footer.nedges = nedges;
+
+        long prev_time = 0;
+
+        for (auto& t: times) {
+            if (encoding == binary_encoding::compact) {
+                w.write_varint(zigzag(t - prev_time));
+                prev_time = t;
+            } else {
+                w.write(int64_t(t));
+            }
+        }
+
+        footer.nvertices = times.size();
+
+        for (auto& v: initials) {
+            w.write(int32_t(v));
+        }
+
+        footer.ninitials = initials.size();
+
+        for (auto& v: finals) {
+            w.write(int32_t(v));
+        }
+
+        footer.nfinals = finals.size();
+
+        // No name, and empty attributes and features.
+
+        w.write(uint32_t(0));
+        footer.vertex_attrs_bytes = sizeof(uint32_t);
+
+        w.write(uint32_t(0));
+        footer.edge_attrs_bytes = sizeof(uint32_t);
+
+        w.write(uint32_t(0));
+        footer.feats_bytes = sizeof(uint32_t);
+
+        footer.encoding = uint32_t(encoding);
+        footer.magic = record_magic;
+
+        w.write(footer);
+        w.flush();
+
+        closed = true;
+    }
+
+    text_stream_writer::text_stream_writer(std::ostream& os, symbol_table const *symbols,
+        bool acceptor)
+        : w(os), symbols(symbols), acceptor(acceptor)
+        , nvertices(0), max_vertex(-1), initial(-1), has_edges(false), closed(false)
+    {}
+
+    text_stream_writer::~text_stream_writer()
+    {
+        close();
+    }
+
+    void text_stream_writer::add_vertex(long /* time */)
+    {
+        ++nvertices;
+    }
+
+    void text_stream_writer::add_edge(edge_data const& e)
+    {
+        if (!has_edges && e.tail != initial) {
+            std::cerr << "the first edge must leave the initial vertex" << std::endl;
+            exit(1);
+        }
+
+        if (acceptor && e.input != e.output) {
+            std::cerr << "edge with different labels in an acceptor" << std::endl;
+            exit(1);
+        }
+
+        has_edges = true;
+        max_vertex = std::max(max_vertex, std::max(e.tail, e.head));
+
+        char buf[64];
+        int n = std::snprintf(buf, sizeof(buf), "%d\t%d\t", e.tail, e.head);
+        w.write(buf, n);
+
+        write_label(e.input);
+
+        if (!acceptor) {
+            w.write('\t');
+            write_label(e.output);
+        }
+
+        if (e.weight != 0) {
+            w.write('\t');
+
+            double cost = -e.weight;
+
+            if (std::isinf(cost)) {
+                n = std::snprintf(buf, sizeof(buf), cost > 0 ? "Infinity" : "-Infinity");
+            } else {
+                // The shortest of the two that reads back exactly.
+
+                n = std::snprintf(buf, sizeof(buf), "%.15g", cost);
+
+                if (std::strtod(buf, nullptr) != cost) {
+                    n = std::snprintf(buf, sizeof(buf), "%.17g", cost);
+                }
+            }
+
+            w.write(buf, n);
+        }
+
+        w.write('\n');
+    }
+
+    void text_stream_writer::add_initial(int v)
+    {
+        if (initial != -1 || has_edges) {
+            std::cerr << "the text format has one initial vertex, added before the edges" << std::endl;
+            exit(1);
+        }
+
+        max_vertex = std::max(max_vertex, v);
+        initial = v;
+    }
+
+    void text_stream_writer::add_final(int v)
+    {
+        max_vertex = std::max(max_vertex, v);
+        finals.push_back(v);
+    }
+
+    void text_stream_writer::close()
+    {
+        if (closed) {
+            return;
+        }
+
+        if (max_vertex >= nvertices) {
+            std::cerr << "vertex " << max_vertex << " used but not added" << std::endl;
+            exit(1);
+        }
+
+        // Without edges, the first line must be the initial vertex, and
+        // no other final vertex can be reached anyway.
+
+        if (!has_edges) {
+            bool initial_final = std::find(finals.begin(), finals.end(), initial) != finals.end();
+            finals = initial_final ? std::vector<int> { initial } : std::vector<int> {};
+        }
+
+        for (auto& v: finals) {
+            char buf[16];
+            int n = std::snprintf(buf, sizeof(buf), "%d\n", v);
+            w.write(buf, n);
+        }
+
+        w.flush();
+
+        closed = true;
+    }
+
+    void text_stream_writer::write_label(int label)
+    {
+        if (symbols == nullptr) {
+            char buf[16];
+            int n = std::snprintf(buf, sizeof(buf), "%d", label);
+            w.write(buf, n);
+
+            return;
+        }
+
+        std::vector<std::string> const& id_symbol = *symbols->id_symbol;
+
+        if (label < 0 || label >= id_symbol.size() || id_symbol[label].size() == 0) {
+            std::cerr << "no symbol for label " << label << std::endl;
+            exit(1);
+        }
+
+        w.write(id_symbol[label].data(), id_symbol[label].size());
+    }
+
+}
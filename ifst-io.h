@@ -0,0 +1,389 @@
+#ifndef IFST_IO_H
+#define IFST_IO_H
+
+#include "fst/ifst.h"
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <unordered_set>
+
+namespace ifst {
+
+    /*
+     * A file mapped read-only into memory, unmapped when destroyed.
+     * An empty file has `data == nullptr`.  The kernel is told to read
+     * ahead if the file is read `sequential`ly, and not to otherwise,
+     * as for an archive read by key.
+     *
+     */
+    struct mapped_file {
+
+        char const *data;
+        long size;
+
+        mapped_file(std::string const& filename, bool sequential = true);
+        ~mapped_file();
+
+        mapped_file(mapped_file const&) = delete;
+        mapped_file& operator=(mapped_file const&) = delete;
+
+    };
+
+    /*
+     * The two halves of a symbol table as kept in `fst_data`.  Tables
+     * are meant to be shared, so assigning them to many fsts does not
+     * copy anything.
+     *
+     */
+    struct symbol_table {
+        std::shared_ptr<std::unordered_map<std::string, int>> symbol_id;
+        std::shared_ptr<std::vector<std::string>> id_symbol;
+    };
+
+    /*
+     * Reads an OpenFst symbol table, one "symbol id" pair per line.
+     * Ids that do not appear map to the empty string in `id_symbol`.
+     *
+     */
+    symbol_table load_symbol_table(std::string const& filename);
+
+    /*
+     * Reads the AT&T (OpenFst) text format:
+     *
+     *     tail head input output [weight]    an edge
+     *     vertex [weight]                    a final vertex
+     *
+     * For an acceptor, edges have one label, used as input and output.
+     * Fields are separated by spaces or tabs.  The first field of the
+     * first line is the initial vertex.  Vertices are 0 to the largest
+     * id in the file, all with time 0, and edges are numbered in the
+     * order of the lines.
+     *
+     * Weights are costs, as in OpenFst, and are negated into scores.
+     * Since `ifst` has no final weights, final vertices with a weight
+     * other than 0 get an edge labeled `::fst::symbol_trait<int>::eps`
+     * to a new final vertex, carrying the weight.  A final weight of
+     * Infinity means the vertex is not final.
+     *
+     * Labels are integers, or symbols looked up in `symbols`, which is
+     * then shared with the result.
+     *
+     * The file is mapped into memory, split into `nthreads` chunks at
+     * line boundaries, and the chunks are parsed in parallel without
+     * allocating per line, then assembled with `bulk_build`.  Malformed
+     * lines and unknown symbols are reported with their line number,
+     * and the program exits.
+     *
+     */
+    fst load_text(std::string const& filename, bool acceptor = false, int nthreads = 1);
+
+    fst load_text(std::string const& filename, symbol_table const& symbols,
+        bool acceptor = false, int nthreads = 1);
+
+    /*
+     * Same as `load_text`, but parses `size` bytes from `text`.
+     * `symbols` can be null for integer labels.
+     *
+     */
+    fst parse_text(char const *text, long size, symbol_table const *symbols,
+        bool acceptor = false, int nthreads = 1);
+
+    /*
+     * Binary format, in native byte order.  A record holds, in order,
+     * the edges as `edge_data`, the vertex times, the initials, the
+     * finals, the name, the vertex and edge attributes and the
+     * features of the edges that have any, and ends with a fixed-size
+     * footer with the sizes of the sections.  With the sizes at the
+     * end, a record can be written before the number of edges is
+     * known.  Symbol tables are not stored.
+     *
+     * Vertex and edge ids are kept if they are 0 to n - 1, as with
+     * `add_vertex` in order, `bulk_build` and the readers here.
+     * Otherwise they are renumbered in the order of `vertex_indices`
+     * and `edge_indices`.
+     *
+     * `write_binary` returns the number of bytes written.
+     * `read_binary` builds the fst with `bulk_build`, whatever the
+     * encoding of the record.  Truncated or corrupt records are
+     * reported and the program exits.
+     *
+     */
+    enum class binary_encoding {
+        raw,
+
+        /*
+         * Edges stay in id order; they are not sorted when written, so
+         * that ids survive a round trip.  The tail is a zigzag varint
+         * delta from the tail of the previous edge, the head a delta
+         * from the tail, the input a varint, and the output a delta
+         * from the input.  Vertex times are deltas as well.  The tail
+         * deltas are only small if edges are grouped by tail and
+         * vertices numbered in topological order, so call `renumber`
+         * with its default orders before writing, unless the fst comes
+         * from `stream_expand` or is already numbered that way.
+         *
+         * Weights are kept exactly, or, with a `weight_step` greater
+         * than 0, rounded to a multiple of it and stored as a varint,
+         * which changes them by at most `weight_step / 2`.
+         */
+        compact
+    };
+
+    long write_binary(std::ostream& os, fst const& f,
+        binary_encoding encoding = binary_encoding::raw, double weight_step = 0);
+
+    fst read_binary(char const *data, long size, int nthreads = 1);
+
+    /*
+     * Decodes the edges, vertex times, initials and finals of a record
+     * into plain arrays, indexed by id, without building an `fst_data`.
+     * The name, attributes and features are skipped.  Most of the time
+     * of `read_binary` goes into the edge maps of `bulk_build`, so this
+     * is the faster path when only the arrays are needed, e.g., to scan
+     * the edges once.  The arrays are checked as in `read_binary`.
+     *
+     */
+    void read_binary_arrays(char const *data, long size,
+        std::vector<vertex_data>& vertices, std::vector<edge_data>& edges,
+        std::vector<int>& initials, std::vector<int>& finals);
+
+    void save_binary(std::string const& filename, fst const& f,
+        binary_encoding encoding = binary_encoding::raw, double weight_step = 0);
+
+    fst load_binary(std::string const& filename, int nthreads = 1);
+
+    /*
+     * An archive of binary records, each with a string key, followed by
+     * an index of the keys and the offsets of the records.  Records are
+     * written one after another as they come, so a decoder can stream
+     * lattices into an archive; the index is written by `close`, which
+     * the destructor calls.  A failed write is reported on `std::cerr`
+     * and exits, as a failed read does.
+     *
+     */
+    struct archive_writer {
+
+        struct entry {
+            std::string key;
+            long offset;
+            long size;
+        };
+
+        std::string filename;
+        std::ofstream ofs;
+        long offset;
+        std::vector<entry> index;
+        bool closed;
+
+        binary_encoding encoding;
+        double weight_step;
+
+        archive_writer(std::string const& filename,
+            binary_encoding encoding = binary_encoding::raw, double weight_step = 0);
+        ~archive_writer();
+
+        void add(std::string const& key, fst const& f);
+        void close();
+
+    };
+
+    /*
+     * Maps an archive and reads its index.  A record is found by
+     * position or key in constant time and read straight from the
+     * mapping, so only its pages are touched.  Readers share nothing,
+     * so several processes can each take a `shard` of the archive.
+     *
+     */
+    struct archive_reader {
+
+        mapped_file file;
+        std::vector<archive_writer::entry> index;
+        std::unordered_map<std::string, int> positions;
+
+        archive_reader(std::string const& filename);
+
+        int size() const;
+        std::string const& key(int i) const;
+
+        /*
+         * The position of `key`, or -1 if it is not in the archive.
+         */
+        int position(std::string const& key) const;
+
+        fst read(int i, int nthreads = 1) const;
+        fst read(std::string const& key, int nthreads = 1) const;
+
+        /*
+         * The positions [first, second) of shard `i` out of `n`, which
+         * differ in size by at most one.
+         */
+        std::pair<int, int> shard(int i, int n) const;
+
+    };
+
+    /*
+     * Writes to a stream through a buffer of at most `buffer_size`
+     * bytes and counts the bytes.
+     *
+     */
+    struct binary_writer {
+
+        static long const buffer_size = 1 << 16;
+
+        std::ostream& os;
+        long bytes;
+        std::vector<char> buffer;
+
+        binary_writer(std::ostream& os);
+        ~binary_writer();
+
+        binary_writer(binary_writer const&) = delete;
+        binary_writer& operator=(binary_writer const&) = delete;
+
+        void flush();
+
+        void write(void const *p, long size);
+
+        template <class T>
+        void write(T const& t)
+        {
+            write(&t, sizeof(T));
+        }
+
+        void write_varint(uint64_t v);
+        void write_string(std::string const& s);
+
+    };
+
+    /*
+     * Receives an fst one piece at a time, e.g., from `stream_expand`,
+     * and writes it out without keeping the edges.  Vertices are
+     * numbered 0, 1, ... in the order of `add_vertex`.  An edge may be
+     * added before its vertices, as long as they are all added by
+     * `close`, which the destructors call.
+     *
+     */
+    struct stream_writer {
+
+        virtual ~stream_writer() = default;
+
+        virtual void add_vertex(long time) = 0;
+        virtual void add_edge(edge_data const& e) = 0;
+        virtual void add_initial(int v) = 0;
+        virtual void add_final(int v) = 0;
+
+        virtual void close() = 0;
+
+    };
+
+    /*
+     * Writes one binary record, as `write_binary` would, but edges go
+     * to the stream (through a buffer of `binary_writer::buffer_size`
+     * bytes) as they are added.  The format puts edges first and the
+     * sizes in the footer, so nothing needs to be known in advance.
+     * Only the vertex times, initials and finals are kept until
+     * `close`; the record has no name, attributes or features.
+     *
+     */
+    struct binary_stream_writer
+        : public stream_writer {
+
+        binary_writer w;
+        binary_encoding encoding;
+        double weight_step;
+
+        long nedges;
+        int prev_tail;
+        int max_vertex;
+        std::vector<long> times;
+        std::vector<int> initials;
+        std::vector<int> finals;
+        bool closed;
+
+        binary_stream_writer(std::ostream& os,
+            binary_encoding encoding = binary_encoding::raw, double weight_step = 0);
+        virtual ~binary_stream_writer() override;
+
+        virtual void add_vertex(long time) override;
+        virtual void add_edge(edge_data const& e) override;
+        virtual void add_initial(int v) override;
+        virtual void add_final(int v) override;
+
+        virtual void close() override;
+
+    };
+
+    /*
+     * Writes the AT&T text format read by `load_text`, with scores
+     * negated into costs.  Edge lines are written as edges are added,
+     * through a buffer of `binary_writer::buffer_size` bytes, and the
+     * final vertices at `close`.  Vertex times are not written.
+     *
+     * The format has one initial vertex, the tail of the first line,
+     * so there must be one initial, added before the edges, and the
+     * first edge must leave it, as with `stream_expand`.  Labels are
+     * written as symbols if `symbols` is not null.
+     *
+     */
+    struct text_stream_writer
+        : public stream_writer {
+
+        binary_writer w;
+        symbol_table const *symbols;
+        bool acceptor;
+
+        int nvertices;
+        int max_vertex;
+        int initial;
+        bool has_edges;
+        std::vector<int> finals;
+        bool closed;
+
+        text_stream_writer(std::ostream& os, symbol_table const *symbols = nullptr,
+            bool acceptor = false);
+        virtual ~text_stream_writer() override;
+
+        virtual void add_vertex(long time) override;
+        virtual void add_edge(edge_data const& e) override;
+        virtual void add_initial(int v) override;
+        virtual void add_final(int v) override;
+
+        virtual void close() override;
+
+        void write_label(int label);
+
+    };
+
+    /*
+     * Expands `f` breadth-first from its initials and passes the
+     * vertices and edges to `w` as they are discovered, then the
+     * finals that were reached, and closes `w`.  This writes a lazy
+     * composition, e.g., `lazy_pair_mode1_fst`, without collecting its
+     * edges; only a map from the vertices of `f` to their ids is kept.
+     * Since vertices are numbered in the order they are expanded, the
+     * edges come out sorted by tail, which suits `binary_encoding::compact`.
+     *
+     * `time` maps a vertex to its time, as for `token_passing`.
+     * Without it, all times are 0.  With `keep`, only the edges for
+     * which `keep(e)` is true are followed, e.g., those retained by
+     * `beam_prune`, as done by `stream_edges`.
+     *
+     */
+    template <class fst_type, class time_fn, class edge_filter>
+    void stream_expand(fst_type const& f, stream_writer& w, time_fn time, edge_filter keep);
+
+    template <class fst_type, class time_fn>
+    void stream_expand(fst_type const& f, stream_writer& w, time_fn time);
+
+    template <class fst_type>
+    void stream_expand(fst_type const& f, stream_writer& w);
+
+    template <class fst_type>
+    void stream_edges(fst_type const& f, std::vector<typename fst_type::edge> const& edges,
+        stream_writer& w);
+
+}
+
+#include "fst/ifst-io-impl.h"
+
+#endif
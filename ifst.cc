@@ -1,6 +1,7 @@
 #include "fst/ifst.h"
 #include "ebt/ebt.h"
 #include <cassert>
+#include <thread>
 
 namespace ifst {
 
@@ -64,6 +65,232 @@ namespace ifst {
         }
     }
 
+    void bulk_build(fst_data& data, std::vector<vertex_data> vertices,
+        std::vector<edge_data> edges, int nthreads)
+    {
+        assert(data.vertices.size() == 0 && data.edges.size() == 0);
+
+        int nv = vertices.size();
+        int ne = edges.size();
+
+        data.vertices = std::move(vertices);
+        data.edges = std::move(edges);
+
+        data.vertex_indices.resize(nv);
+        data.vertex_set.reserve(nv);
+
+        for (int v = 0; v < nv; ++v) {
+            data.vertex_indices[v] = v;
+            data.vertex_set.insert(v);
+        }
+
+        data.edge_indices.resize(ne);
+        data.edge_set.reserve(ne);
+
+        for (int e = 0; e < ne; ++e) {
+            data.edge_indices[e] = e;
+            data.edge_set.insert(e);
+        }
+
+        data.in_edges.resize(nv);
+        data.out_edges.resize(nv);
+
+        std::vector<int> in_degree(nv);
+        std::vector<int> out_degree(nv);
+
+        for (auto& e: data.edges) {
+            assert(0 <= e.tail && e.tail < nv && 0 <= e.head && e.head < nv);
+
+            ++in_degree[e.head];
+            ++out_degree[e.tail];
+        }
+
+        for (int v = 0; v < nv; ++v) {
+            data.in_edges[v].reserve(in_degree[v]);
+            data.out_edges[v].reserve(out_degree[v]);
+        }
+
+        for (int e = 0; e < ne; ++e) {
+            data.in_edges[data.edges[e].head].push_back(e);
+            data.out_edges[data.edges[e].tail].push_back(e);
+        }
+
+        data.in_edges_input_map.resize(nv);
+        data.in_edges_output_map.resize(nv);
+        data.out_edges_input_map.resize(nv);
+        data.out_edges_output_map.resize(nv);
+
+        auto build_maps = [&](int begin, int end) {
+            for (int v = begin; v < end; ++v) {
+                for (auto& e: data.in_edges[v]) {
+                    data.in_edges_input_map[v][data.edges[e].input].push_back(e);
+                    data.in_edges_output_map[v][data.edges[e].output].push_back(e);
+                }
+
+                for (auto& e: data.out_edges[v]) {
+                    data.out_edges_input_map[v][data.edges[e].input].push_back(e);
+                    data.out_edges_output_map[v][data.edges[e].output].push_back(e);
+                }
+            }
+        };
+
+        nthreads = std::max(1, std::min(nthreads, nv));
+
+        std::vector<std::thread> threads;
+
+        for (int t = 1; t < nthreads; ++t) {
+            threads.emplace_back(build_maps, long(nv) * t / nthreads, long(nv) * (t + 1) / nthreads);
+        }
+
+        build_maps(0, nv / nthreads);
+
+        for (auto& t: threads) {
+            t.join();
+        }
+
+        data.vertex_attrs.resize(nv);
+        data.edge_attrs.resize(ne);
+        data.feats.resize(ne);
+    }
+
+    namespace {
+
+        memory_size operator+(memory_size const& a, memory_size const& b)
+        {
+            return memory_size { a.size + b.size, a.capacity + b.capacity };
+        }
+
+        template <class T>
+        memory_size heap_memory(std::vector<T> const& v)
+        {
+            return memory_size { long(v.size() * sizeof(T)), long(v.capacity() * sizeof(T)) };
+        }
+
+        memory_size heap_memory(std::string const& s)
+        {
+            // Short strings are stored inside the object.
+            if (s.capacity() <= 15) {
+                return memory_size { 0, 0 };
+            }
+
+            return memory_size { long(s.size() + 1), long(s.capacity() + 1) };
+        }
+
+        memory_size heap_memory(std::vector<std::vector<int>> const& v)
+        {
+            memory_size result = heap_memory<std::vector<int>>(v);
+
+            for (auto& u: v) {
+                result = result + heap_memory(u);
+            }
+
+            return result;
+        }
+
+        memory_size heap_memory(std::vector<std::vector<double>> const& v)
+        {
+            memory_size result = heap_memory<std::vector<double>>(v);
+
+            for (auto& u: v) {
+                result = result + heap_memory(u);
+            }
+
+            return result;
+        }
+
+        memory_size heap_memory(std::vector<std::unordered_map<int, std::vector<int>>> const& maps)
+        {
+            long node_bytes = sizeof(std::pair<int const, std::vector<int>>) + sizeof(void*);
+
+            memory_size result = heap_memory<std::unordered_map<int, std::vector<int>>>(maps);
+
+            for (auto& m: maps) {
+                result.capacity += m.bucket_count() * sizeof(void*);
+
+                for (auto& p: m) {
+                    result = result + memory_size { node_bytes, node_bytes } + heap_memory(p.second);
+                }
+            }
+
+            return result;
+        }
+
+        memory_size heap_memory(std::unordered_set<int> const& s)
+        {
+            long node_bytes = s.size() * (sizeof(int) + sizeof(void*));
+
+            return memory_size { node_bytes, long(node_bytes + s.bucket_count() * sizeof(void*)) };
+        }
+
+        memory_size heap_memory(
+            std::vector<std::vector<std::pair<std::string, std::string>>> const& attrs)
+        {
+            memory_size result = heap_memory<std::vector<std::pair<std::string, std::string>>>(attrs);
+
+            for (auto& v: attrs) {
+                result = result + heap_memory(v);
+
+                for (auto& p: v) {
+                    result = result + heap_memory(p.first) + heap_memory(p.second);
+                }
+            }
+
+            return result;
+        }
+
+    }
+
+    memory_size fst_memory::total() const
+    {
+        return vertices + edges + indices + adjacency
+            + in_edges_input_map + in_edges_output_map
+            + out_edges_input_map + out_edges_output_map
+            + vertex_set + edge_set + vertex_attrs + edge_attrs
+            + feats + symbol_tables;
+    }
+
+    fst_memory memory_usage(fst_data const& data)
+    {
+        fst_memory result;
+
+        result.vertices = heap_memory(data.vertices);
+        result.edges = heap_memory(data.edges);
+        result.indices = heap_memory(data.vertex_indices) + heap_memory(data.edge_indices)
+            + heap_memory(data.initials) + heap_memory(data.finals);
+        result.adjacency = heap_memory(data.in_edges) + heap_memory(data.out_edges);
+        result.in_edges_input_map = heap_memory(data.in_edges_input_map);
+        result.in_edges_output_map = heap_memory(data.in_edges_output_map);
+        result.out_edges_input_map = heap_memory(data.out_edges_input_map);
+        result.out_edges_output_map = heap_memory(data.out_edges_output_map);
+        result.vertex_set = heap_memory(data.vertex_set);
+        result.edge_set = heap_memory(data.edge_set);
+        result.vertex_attrs = heap_memory(data.vertex_attrs);
+        result.edge_attrs = heap_memory(data.edge_attrs);
+        result.feats = heap_memory(data.feats);
+        result.symbol_tables = memory_size { 0, 0 };
+
+        if (data.symbol_id != nullptr) {
+            long node_bytes = sizeof(std::pair<std::string const, int>) + 2 * sizeof(void*);
+
+            result.symbol_tables.capacity += data.symbol_id->bucket_count() * sizeof(void*);
+
+            for (auto& p: *data.symbol_id) {
+                result.symbol_tables = result.symbol_tables
+                    + memory_size { node_bytes, node_bytes } + heap_memory(p.first);
+            }
+        }
+
+        if (data.id_symbol != nullptr) {
+            result.symbol_tables = result.symbol_tables + heap_memory(*data.id_symbol);
+
+            for (auto& s: *data.id_symbol) {
+                result.symbol_tables = result.symbol_tables + heap_memory(s);
+            }
+        }
+
+        return result;
+    }
+
     std::vector<int> const& fst::vertices() const
     {
         return data->vertex_indices;
@@ -144,6 +371,230 @@ namespace ifst {
         return data->vertices.at(v).time;
     }
 
+    namespace {
+
+        /*
+         * The list or map of the wrapped fst at `v` plus the loop, built
+         * into `cache` unless it already holds `v`.  Assigning into the
+         * old contents reuses their storage.
+         *
+         */
+        std::vector<int> const& with_loop(eps_loop_fst::slot<std::vector<int>>& cache,
+            int v, std::vector<int> const& edges, int loop)
+        {
+            if (cache.vertex != v) {
+                cache.value.assign(edges.begin(), edges.end());
+                cache.value.push_back(loop);
+                cache.vertex = v;
+            }
+
+            return cache.value;
+        }
+
+        std::unordered_map<int, std::vector<int>> const& with_loop(
+            eps_loop_fst::slot<std::unordered_map<int, std::vector<int>>>& cache,
+            int v, std::unordered_map<int, std::vector<int>> const& map, int label, int loop)
+        {
+            if (cache.vertex != v) {
+                cache.value = map;
+                cache.value[label].push_back(loop);
+                cache.vertex = v;
+            }
+
+            return cache.value;
+        }
+
+    }
+
+    eps_loop_fst::eps_loop_fst(fst f, int label)
+        : f(f), label(label), loop_base(f.data->edges.size())
+    {}
+
+    bool eps_loop_fst::is_loop(int e) const
+    {
+        return e >= loop_base;
+    }
+
+    std::vector<int> const& eps_loop_fst::vertices() const
+    {
+        return f.vertices();
+    }
+
+    std::vector<int> const& eps_loop_fst::edges() const
+    {
+        if (edges_cache == nullptr) {
+            edges_cache = std::make_shared<std::vector<int>>(f.edges());
+
+            for (auto& v: f.vertices()) {
+                edges_cache->push_back(loop_base + v);
+            }
+        }
+
+        return *edges_cache;
+    }
+
+    double eps_loop_fst::weight(int e) const
+    {
+        return is_loop(e) ? 0 : f.weight(e);
+    }
+
+    std::vector<int> const& eps_loop_fst::in_edges(int v) const
+    {
+        return with_loop(in_edges_cache, v, f.in_edges(v), loop_base + v);
+    }
+
+    std::vector<int> const& eps_loop_fst::out_edges(int v) const
+    {
+        return with_loop(out_edges_cache, v, f.out_edges(v), loop_base + v);
+    }
+
+    int eps_loop_fst::tail(int e) const
+    {
+        return is_loop(e) ? e - loop_base : f.tail(e);
+    }
+
+    int eps_loop_fst::head(int e) const
+    {
+        return is_loop(e) ? e - loop_base : f.head(e);
+    }
+
+    std::vector<int> const& eps_loop_fst::initials() const
+    {
+        return f.initials();
+    }
+
+    std::vector<int> const& eps_loop_fst::finals() const
+    {
+        return f.finals();
+    }
+
+    int const& eps_loop_fst::input(int e) const
+    {
+        return is_loop(e) ? label : f.input(e);
+    }
+
+    int const& eps_loop_fst::output(int e) const
+    {
+        return is_loop(e) ? label : f.output(e);
+    }
+
+    long eps_loop_fst::time(int v) const
+    {
+        return f.time(v);
+    }
+
+    std::unordered_map<int, std::vector<int>> const& eps_loop_fst::in_edges_input_map(int v) const
+    {
+        return with_loop(in_edges_input_map_cache, v, f.in_edges_input_map(v), label, loop_base + v);
+    }
+
+    std::unordered_map<int, std::vector<int>> const& eps_loop_fst::in_edges_output_map(int v) const
+    {
+        return with_loop(in_edges_output_map_cache, v, f.in_edges_output_map(v), label, loop_base + v);
+    }
+
+    std::unordered_map<int, std::vector<int>> const& eps_loop_fst::out_edges_input_map(int v) const
+    {
+        return with_loop(out_edges_input_map_cache, v, f.out_edges_input_map(v), label, loop_base + v);
+    }
+
+    std::unordered_map<int, std::vector<int>> const& eps_loop_fst::out_edges_output_map(int v) const
+    {
+        return with_loop(out_edges_output_map_cache, v, f.out_edges_output_map(v), label, loop_base + v);
+    }
+
+    reweighted_fst::reweighted_fst(fst f)
+        : topology(f), weights(std::make_shared<std::vector<double>>(f.data->edges.size()))
+    {
+        for (auto& e: f.edges()) {
+            (*weights)[e] = f.weight(e);
+        }
+    }
+
+    reweighted_fst::reweighted_fst(fst f, std::shared_ptr<std::vector<double>> weights)
+        : topology(f), weights(weights)
+    {}
+
+    std::vector<int> const& reweighted_fst::vertices() const
+    {
+        return topology.vertices();
+    }
+
+    std::vector<int> const& reweighted_fst::edges() const
+    {
+        return topology.edges();
+    }
+
+    double reweighted_fst::weight(int e) const
+    {
+        return weights->at(e);
+    }
+
+    std::vector<int> const& reweighted_fst::in_edges(int v) const
+    {
+        return topology.in_edges(v);
+    }
+
+    std::vector<int> const& reweighted_fst::out_edges(int v) const
+    {
+        return topology.out_edges(v);
+    }
+
+    int reweighted_fst::tail(int e) const
+    {
+        return topology.tail(e);
+    }
+
+    int reweighted_fst::head(int e) const
+    {
+        return topology.head(e);
+    }
+
+    std::vector<int> const& reweighted_fst::initials() const
+    {
+        return topology.initials();
+    }
+
+    std::vector<int> const& reweighted_fst::finals() const
+    {
+        return topology.finals();
+    }
+
+    int const& reweighted_fst::input(int e) const
+    {
+        return topology.input(e);
+    }
+
+    int const& reweighted_fst::output(int e) const
+    {
+        return topology.output(e);
+    }
+
+    long reweighted_fst::time(int v) const
+    {
+        return topology.time(v);
+    }
+
+    std::unordered_map<int, std::vector<int>> const& reweighted_fst::in_edges_input_map(int v) const
+    {
+        return topology.in_edges_input_map(v);
+    }
+
+    std::unordered_map<int, std::vector<int>> const& reweighted_fst::in_edges_output_map(int v) const
+    {
+        return topology.in_edges_output_map(v);
+    }
+
+    std::unordered_map<int, std::vector<int>> const& reweighted_fst::out_edges_input_map(int v) const
+    {
+        return topology.out_edges_input_map(v);
+    }
+
+    std::unordered_map<int, std::vector<int>> const& reweighted_fst::out_edges_output_map(int v) const
+    {
+        return topology.out_edges_output_map(v);
+    }
+
     fst add_eps_loops(fst f, int label)
     {
         fst_data& data = *(f.data);
@@ -60,6 +60,56 @@ namespace ifst {
     void add_vertex(fst_data& data, int v, vertex_data v_data);
     void add_edge(fst_data& data, int e, edge_data e_data);
 
+    /*
+     * Adds vertices 0 to `vertices.size() - 1` and edges 0 to
+     * `edges.size() - 1` to an empty `data`.  The result is the same as
+     * calling `add_vertex` and `add_edge` in order, but every container
+     * is sized once, and the edge maps, which take most of the time,
+     * are built by `nthreads` threads over disjoint ranges of vertices.
+     *
+     */
+    void bulk_build(fst_data& data, std::vector<vertex_data> vertices,
+        std::vector<edge_data> edges, int nthreads = 1);
+
+    struct memory_size {
+        long size;
+        long capacity;
+    };
+
+    /*
+     * Heap bytes used by each part of an `fst_data`; the `fst_data`
+     * object itself is not counted.  `size` counts what the elements
+     * take, and `capacity` what is allocated, adding spare capacity of
+     * vectors and the buckets of hash containers.  Node and string
+     * overheads are estimates for libstdc++.
+     *
+     * `indices` covers `vertex_indices`, `edge_indices`, `initials`
+     * and `finals`, and `adjacency` covers `in_edges` and `out_edges`.
+     * The symbol tables are often shared by many fsts and are counted
+     * in full.
+     *
+     */
+    struct fst_memory {
+        memory_size vertices;
+        memory_size edges;
+        memory_size indices;
+        memory_size adjacency;
+        memory_size in_edges_input_map;
+        memory_size in_edges_output_map;
+        memory_size out_edges_input_map;
+        memory_size out_edges_output_map;
+        memory_size vertex_set;
+        memory_size edge_set;
+        memory_size vertex_attrs;
+        memory_size edge_attrs;
+        memory_size feats;
+        memory_size symbol_tables;
+
+        memory_size total() const;
+    };
+
+    fst_memory memory_usage(fst_data const& data);
+
     /*
      * The class `fst_data` is separated instead of inlined in `fst`,
      * because we want to separate data (`fst_data`) that can be manipulated
@@ -99,6 +149,127 @@ namespace ifst {
 
     };
 
+    /*
+     * `f` with an eps loop on every vertex, as `add_eps_loops` would
+     * add, but without touching `f`.  The loop on vertex `v` has edge
+     * id `loop_base + v`, where `loop_base` is the size of `edges` in
+     * `f` when the view is made, and weight zero.
+     *
+     * Adjacency lists and edge maps that include the loop are built
+     * when asked for, into one buffer per accessor that is reused, so
+     * the view holds at most one list or map of each kind.  As with
+     * `lazy_pair_fst`, a reference returned by one of these accessors
+     * is valid until the next call to the same accessor for another
+     * vertex.
+     *
+     */
+    struct eps_loop_fst {
+
+        using vertex = int;
+        using edge = int;
+        using input_symbol = int;
+        using output_symbol = int;
+
+        fst f;
+        int label;
+        int loop_base;
+
+        mutable std::shared_ptr<std::vector<int>> edges_cache;
+
+        /*
+         * The last list or map built by an accessor, and the vertex it
+         * is for, or -1.
+         */
+        template <class container>
+        struct slot {
+            int vertex = -1;
+            container value;
+        };
+
+        using edge_list = std::vector<int>;
+        using edge_map = std::unordered_map<int, std::vector<int>>;
+
+        mutable slot<edge_list> in_edges_cache;
+        mutable slot<edge_list> out_edges_cache;
+
+        mutable slot<edge_map> in_edges_input_map_cache;
+        mutable slot<edge_map> in_edges_output_map_cache;
+        mutable slot<edge_map> out_edges_input_map_cache;
+        mutable slot<edge_map> out_edges_output_map_cache;
+
+        eps_loop_fst(fst f, int label=0);
+
+        bool is_loop(int e) const;
+
+        std::vector<int> const& vertices() const;
+        std::vector<int> const& edges() const;
+        double weight(int e) const;
+        std::vector<int> const& in_edges(int v) const;
+        std::vector<int> const& out_edges(int v) const;
+        int tail(int e) const;
+        int head(int e) const;
+        std::vector<int> const& initials() const;
+        std::vector<int> const& finals() const;
+        int const& input(int e) const;
+        int const& output(int e) const;
+
+        long time(int v) const;
+
+        std::unordered_map<int, std::vector<int>> const& in_edges_input_map(int v) const;
+        std::unordered_map<int, std::vector<int>> const& in_edges_output_map(int v) const;
+        std::unordered_map<int, std::vector<int>> const& out_edges_input_map(int v) const;
+        std::unordered_map<int, std::vector<int>> const& out_edges_output_map(int v) const;
+
+    };
+
+    /*
+     * The topology, labels and indices of `topology`, with weights
+     * taken from `weights`, indexed by edge id.  Several
+     * `reweighted_fst`s can share one topology, so scoring a graph
+     * under another model, or with each weight vector of a minibatch,
+     * only needs a new weight vector.  The weights in `topology` itself
+     * are not used, and the topology should not change while it is
+     * shared.
+     *
+     */
+    struct reweighted_fst {
+
+        using vertex = int;
+        using edge = int;
+        using input_symbol = int;
+        using output_symbol = int;
+
+        fst topology;
+        std::shared_ptr<std::vector<double>> weights;
+
+        /*
+         * Starts with a copy of the weights of `f`.
+         */
+        reweighted_fst(fst f);
+
+        reweighted_fst(fst f, std::shared_ptr<std::vector<double>> weights);
+
+        std::vector<int> const& vertices() const;
+        std::vector<int> const& edges() const;
+        double weight(int e) const;
+        std::vector<int> const& in_edges(int v) const;
+        std::vector<int> const& out_edges(int v) const;
+        int tail(int e) const;
+        int head(int e) const;
+        std::vector<int> const& initials() const;
+        std::vector<int> const& finals() const;
+        int const& input(int e) const;
+        int const& output(int e) const;
+
+        long time(int v) const;
+
+        std::unordered_map<int, std::vector<int>> const& in_edges_input_map(int v) const;
+        std::unordered_map<int, std::vector<int>> const& in_edges_output_map(int v) const;
+        std::unordered_map<int, std::vector<int>> const& out_edges_input_map(int v) const;
+        std::unordered_map<int, std::vector<int>> const& out_edges_output_map(int v) const;
+
+    };
+
     fst add_eps_loops(fst f, int label=0);
 
 }